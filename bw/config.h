@@ -27,6 +27,10 @@ by Arnold Schommer
 // some WeMos (?) board with onboard-SSD1306 & battery holder  (18650 size)
 #define U8G2_DECLARATION U8G2_SSD1306_128X64_NONAME_F_HW_I2C u8g2
 #define U8G2_CONSTRUCTION U8G2_DECLARATION(/* u8g2_cb_t *rotation = */ U8G2_R0, /* reset = */ U8X8_PIN_NONE, /* SCL= */ 4, /* SDA= */ 5 )
+// optional(!): the size of that display (as rotated) - the drawing code then works with constants instead of
+// asking u8g2 per pixel; must match, else a warning is printed on startup
+#define DISPLAY_WIDTH   128
+#define DISPLAY_HEIGHT  64
 
 // optional(!): brightness to set
 // #define BRIGHTNESS 100
@@ -43,13 +47,61 @@ by Arnold Schommer
 // max. length of wifi nets (to save)
 #define APSTANAMELEN 20
 
-// how long (ms) should each frame be showed during the slideshow?
+// filesystem for the images: SPIFFS (default) or LittleFS (with many files, open/exists are much faster).
+// CAUTION: switching formats the filesystem (on the first start), i.e. all uploaded files are lost!
+//#define USE_LITTLEFS
+// ... or an SD card (for thousands of images), connected by SPI with chip select at SD_CS_PIN
+// (with a SPI display: the bus is shared, the display needs a different CS pin)
+//#define USE_SD
+#define SD_CS_PIN   5
+
+// how long (ms) should each frame be showed during the slideshow? (a playlist may set it per image)
 #define SLIDESHOW_PERIOD 3000
+// the playlist (see slideshow.h) the slideshow plays when started without choosing one - if it exists
+#define SLIDESHOW_DEFAULT_PLAYLIST  "/slideshow.lst"
+
+// synchronized slideshows (see sync.h; leader/follower are chosen on the settings page):
+// the multicast group and port used, how often (ms) the leader tells its clock and the next slide
+#define SYNC_GROUP      IPAddress(239, 84, 71, 68)
+#define SYNC_PORT       4268
+#define SYNC_INTERVAL   500
+
+// live frames (see stream.h): the UDP port listened to (the WebSocket is /stream), and how many bytes of
+// WebSocket packets may wait for loop()
+#define STREAM_PORT         4269
+#define STREAM_QUEUE_SIZE   4096
+
+// battery powered: let the WiFi modem sleep between the beacons (in station mode) and run the ESP32 at 80 MHz;
+// the pages answer a bit slower and drawing takes longer (the slideshow starts it earlier accordingly)
+//#define POWER_SAVE
 
-// (max.) buffer slots for images:
-#define SLIDESHOW_MAX_IMAGES    64
+// images in 4 gray levels (see grayscale.h): two bit planes alternated every GRAYSCALE_PERIOD ms - the display
+// has to be flushed faster than that (SPI; I2C at 400 kHz takes about 25 ms for 128x64, which flickers);
+// takes 4 more display buffers of memory, the image cache is not used then; rotation U8G2_R0 only
+//#define GRAYSCALE
+#define GRAYSCALE_PERIOD    8
+
+// images listed per page (on the main page):
+#define LIST_PAGE_SIZE          32
 // (max.) filename length (i did not find a define for how long an SPIFFS filename may be); longer filenames will be cut to this!
 #define MAX_FILENAME_LEN        32
 
+// uploads are collected into pieces of this size before being written to the filesystem
+// (the flash is erased/written in 4k sectors; smaller writes cost extra erase cycles and time)
+#define UPLOAD_BUFFER_SIZE      4096
+
+// diagnostic messages: the levels above LOG_LEVEL are not even compiled (see log.h)
+// LOG_LEVEL_NONE, LOG_LEVEL_ERROR, LOG_LEVEL_WARN, LOG_LEVEL_INFO or LOG_LEVEL_DEBUG
+#define LOG_LEVEL               LOG_LEVEL_INFO
+// the messages are kept in a ring buffer of this size (shown at /log) and sent to the serial port when idle
+#define LOG_BUFFER_SIZE         4096
+
+// images drawn recently are kept as display buffers (see imagecache.h), to be shown again at once:
+// how many bytes to use for them - of the RAM, of the PSRAM (if the ESP32 has it); 0: no cache
+#define IMAGE_CACHE_SIZE        8192
+#define IMAGE_CACHE_PSRAM_SIZE  (1024*1024UL)
+// the scratch memory for drawing (see rendercore.h), in bytes; 0: as much as the display size requires
+#define RENDER_ARENA_SIZE       0
+
 
 #endif _CONFIG_H
@@ -14,14 +14,40 @@ u8g2 variant
 #ifndef GFXLAYER_H
 #define GFXLAYER_H
 
+#ifdef GRAYSCALE    // (see grayscale.h: the planes of an image are alternated until something else is shown)
+void gray_flush(void);
+void gray_stop(void);
+inline void gfx_flushBuffer(void)                               { gray_flush(); }
+inline void gfx_clearScreen(void)                               { gray_stop(); u8g2.clearDisplay(); }
+#else
 inline void gfx_flushBuffer(void)                               { u8g2.sendBuffer(); }  // write the whole buffer to the display - only needed if the gfx system uses a framebuffer instead of writing everything to the display immediately
 inline void gfx_clearScreen(void)                               { u8g2.clearDisplay(); }
+#endif
+inline void gfx_clearBuffer(void)                               { u8g2.clearBuffer(); } // like gfx_clearScreen(), but the display shows it by the next gfx_flushBuffer() only
+#ifdef DISPLAY_WIDTH    // known at compile time (config.h): constants in the drawing loops
+inline uint16_t gfx_getScreenWidth(void)                        { return DISPLAY_WIDTH; }
+inline uint16_t gfx_getScreenHeight(void)                       { return DISPLAY_HEIGHT; }
+#else
 inline uint16_t gfx_getScreenWidth(void)                        { return u8g2.getDisplayWidth(); }
 inline uint16_t gfx_getScreenHeight(void)                       { return u8g2.getDisplayHeight(); }
+#endif
+// false: DISPLAY_WIDTH/DISPLAY_HEIGHT do not match the display configured
+inline bool gfx_checkScreenSize(void)                           { return (gfx_getScreenWidth() == u8g2.getDisplayWidth()) && (gfx_getScreenHeight() == u8g2.getDisplayHeight()); }
 inline void gfx_setPixel(uint16_t x, uint16_t y)                { u8g2.drawPixel(x, y); }
 inline void gfx_setPixelColor(uint8_t c)                        { u8g2.setDrawColor(c); }
 inline void gfx_setTextColor(uint8_t c)                         { u8g2.setDrawColor(c); }
 inline void gfx_drawString(uint16_t x, uint16_t y, const char *str)   { u8g2.drawStr(x,y, str); }
+// direct access to the buffer (NULL: there is none), u8g2 layout: per 8 rows one byte per column, bit 0 on top
+inline uint8_t *gfx_getBuffer(void)                             { return u8g2.getBufferPtr(); }
+inline size_t gfx_getBufferSize(void)                           { return 8 * u8g2.getBufferTileWidth() * u8g2.getBufferTileHeight(); }
+// the buffer was written directly (by gfx_getBuffer()): the next flush sends all of it
+inline void gfx_markBuffer(void)                                { }     // (it always does)
+// like gfx_flushBuffer(), but just (the 8x8 tiles containing) the area given
+#ifdef GRAYSCALE
+inline void gfx_flushArea(uint16_t x, uint16_t y, uint16_t w, uint16_t h)   { gray_stop(); u8g2.updateDisplayArea(x/8, y/8, (x+w+7)/8 - x/8, (y+h+7)/8 - y/8); }
+#else
+inline void gfx_flushArea(uint16_t x, uint16_t y, uint16_t w, uint16_t h)   { u8g2.updateDisplayArea(x/8, y/8, (x+w+7)/8 - x/8, (y+h+7)/8 - y/8); }
+#endif
 
 inline void gfx_init(void)  // calls gfx_clearScreen() and gfx_flushBuffer(); therefore defined afterwards
 {
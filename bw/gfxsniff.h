@@ -0,0 +1,59 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+gfxsniff.h - incremental check of image file headers: is it a file we can display, what size has it?
+
+the data may be fed piecewise (as it arrives during an upload) or from a file; in both cases only
+the header is parsed, nothing is decoded.
+
+*/
+
+#ifndef GFXSNIFF_H
+#define GFXSNIFF_H
+
+/*********************************************************************/
+// data a) scanned from some (potential) gfx file to determine if it can be displayed
+// and b) returned to some "listing" function to display general info on that file
+
+enum GFI_TYPE { GFI_TYPE_INVALID, GFI_TYPE_BMP, GFI_TYPE_JPG, GFI_TYPE_GIF, GFI_TYPE_PNG };
+
+struct gfxFileInfo
+{
+    GFI_TYPE type;
+    uint32_t width;
+    uint32_t height;
+    uint16_t depth; // bits per pixel
+};
+/*********************************************************************/
+
+enum SNIFF_RESULT { SNIFF_MORE, SNIFF_OK, SNIFF_INVALID };
+
+struct gfxSniffer
+{
+    SNIFF_RESULT result;    // SNIFF_MORE until the header is parsed completely
+    uint32_t pos;           // number of bytes fed so far
+    struct gfxFileInfo info;
+    // BMP: the fixed size part of the header is collected here:
+    uint8_t header[34];
+    // JPEG: state of the marker segment walk
+    uint8_t jstate;
+    uint8_t marker;
+    uint16_t remaining;     // bytes of the current segment still to be read/skipped
+};
+
+// determine the image type by the filename extension; GFI_TYPE_INVALID: none we know of
+GFI_TYPE gfxTypeFromFilename(const char *filename);
+
+// prepare a sniffer for a file of type type (as told by gfxTypeFromFilename())
+void sniff_begin(struct gfxSniffer *sniffer, GFI_TYPE type);
+// feed the next len bytes of the file; returns SNIFF_MORE as long as no decision is possible.
+// after SNIFF_OK, sniffer->info holds type, size & depth. Feeding more data after a decision does no harm.
+SNIFF_RESULT sniff_feed(struct gfxSniffer *sniffer, const uint8_t *data, size_t len);
+
+// sniff a file from the filesystem (reads only as much as required); false, if it is no image we can handle
+bool sniffFile(const char *filename, struct gfxFileInfo *info);
+bool sniffFileAs(const char *filename, GFI_TYPE type, struct gfxFileInfo *info);    // type not by the name (partial files)
+
+#endif GFXSNIFF_H
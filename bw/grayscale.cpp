@@ -0,0 +1,127 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+grayscale.cpp - 4 gray levels on a black&white display, implementation
+
+Four buffers of the display buffer's size are allocated when first needed and then kept: the low plane
+being drawn, the two planes shown and a place to save the display buffer while a plane is sent.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include <stdlib.h>
+#include "esplayer.h"
+#include <U8g2lib.h>        // https://github.com/olikraus/u8g2
+extern U8G2_DECLARATION;
+#include "gfxlayer.h"
+#include "slideshow.h"
+#include "grayscale.h"
+#include "log.h"
+
+#ifdef GRAYSCALE
+
+static uint8_t *planes = NULL;
+static uint8_t *drawn_low, *shown_high, *shown_low, *saved;
+static size_t plane_size;
+static uint16_t plane_line;             // bytes per 8 rows
+static bool gray_unusable = false;      // no buffer or no memory: don't try again
+static bool gray_drawn = false;         // an image was drawn in gray levels, not yet shown
+static bool gray_shown = false;         // the planes are alternated
+static bool gray_low;                   // the display shows the low plane
+static uint32_t gray_next;              // millis() of the next switch
+
+static bool gray_alloc(void)
+{
+    if(planes)  return true;
+    if(gray_unusable)   return false;
+    gray_unusable = true;
+    if(!gfx_getBuffer())    return false;
+    plane_size = gfx_getBufferSize();
+    plane_line = 8 * u8g2.getBufferTileWidth();
+    if(esp_psram_size())    planes = (uint8_t *)esp_psram_malloc(4 * plane_size);
+    if(!planes) planes = (uint8_t *)malloc(4 * plane_size);
+    if(!planes)
+    {
+        LOG_WARN("grayscale: no memory for the planes, drawing black&white");
+        return false;
+    }
+    drawn_low  = planes;
+    shown_high = planes + plane_size;
+    shown_low  = planes + 2 * plane_size;
+    saved      = planes + 3 * plane_size;
+    gray_unusable = false;
+    return true;
+}
+
+static void gray_send(const uint8_t *plane)     // show plane, keeping the display buffer
+{
+    uint8_t *buffer = gfx_getBuffer();
+
+    memcpy(saved, buffer, plane_size);
+    memcpy(buffer, plane, plane_size);
+    u8g2.sendBuffer();
+    memcpy(buffer, saved, plane_size);
+}
+
+bool gray_begin(void)
+{
+    if(!gray_alloc())   return false;
+    memset(drawn_low, 0, plane_size);
+    gray_drawn = true;
+    return true;
+}
+
+void gray_setPixel(uint16_t x, uint16_t y)
+{
+    uint32_t pos = x + (y / 8) * plane_line;
+
+    if((x < plane_line) && (pos < plane_size))  drawn_low[pos] |= 1 << (y & 7);
+}
+
+void gray_flush(void)
+{
+    u8g2.sendBuffer();
+    gray_shown = gray_drawn;
+    gray_drawn = false;
+    if(!gray_shown) return;
+    // the planes of the image just drawn: the display buffer is the high one
+    uint8_t *h = shown_low;
+    shown_low = drawn_low;
+    drawn_low = h;
+    memcpy(shown_high, gfx_getBuffer(), plane_size);
+    gray_low = false;
+    gray_next = millis() + 2 * GRAYSCALE_PERIOD;
+}
+
+void gray_stop(void)
+{
+    gray_drawn = false;
+    if(gray_shown && gray_low)  gray_send(shown_high);
+    gray_shown = false;
+}
+
+void gray_loop(void)
+{
+    uint32_t now = millis();
+
+    if(!gray_shown || !time_reached(now, gray_next))    return;
+    gray_low = !gray_low;
+    gray_send(gray_low ? shown_low : shown_high);
+    gray_next += (gray_low ? 1 : 2) * GRAYSCALE_PERIOD;
+    now = millis();
+    if(time_reached(now, gray_next))    gray_next = now + (gray_low ? 1 : 2) * GRAYSCALE_PERIOD;  // fallen behind (drawing, sending): don't catch up
+}
+
+uint32_t gray_idle_time(void)
+{
+    uint32_t now = millis();
+
+    if(!gray_shown) return UINT32_MAX;
+    return time_reached(now, gray_next) ? 0 : gray_next - now;
+}
+
+#endif
@@ -0,0 +1,39 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+grayscale.h - 4 gray levels on a black&white display (GRAYSCALE in config.h): two bit planes alternated
+
+Drawing an image, the dithering quantizes to 4 levels instead of 2: the high bit goes to the display buffer
+as usual, the low bit to a second plane (gray_setPixel()). When the image is shown (gfx_flushBuffer()), both
+planes are copied and from then on alternated by gray_loop(): the high one for 2 periods, the low one for 1
+(GRAYSCALE_PERIOD ms each) - so a pixel is lit 0, 1, 2 or 3 thirds of the time. Switching planes is just
+copying a prepared buffer and sending it, nothing is decoded again; the display buffer is left as it is, so
+the next image may be drawn ahead meanwhile. Anything else shown (text, live frames) stops the alternation.
+
+The second plane is written directly, in the u8g2 buffer layout of rotation U8G2_R0. Without a buffer (or
+memory for 4 of them), images are drawn black&white.
+
+*/
+
+#ifndef GRAYSCALE_H
+#define GRAYSCALE_H
+
+#define GRAY_LEVELS     4
+
+#ifdef GRAYSCALE
+bool gray_begin(void);                          // an image is drawn in gray levels; false: in black&white
+void gray_setPixel(uint16_t x, uint16_t y);     // the low bit of the pixel's level (the high bit: gfx_setPixel())
+void gray_flush(void);                          // gfx_flushBuffer(): show the buffer - and alternate the planes
+void gray_stop(void);                           // something else is shown: the high plane stays
+void gray_loop(void);                           // switch planes when it is time to - to be called from loop()
+uint32_t gray_idle_time(void);                  // ms until gray_loop() has something to do (UINT32_MAX: nothing)
+#else
+inline bool gray_begin(void)                    { return false; }
+inline void gray_setPixel(uint16_t x, uint16_t y)   { }
+inline void gray_loop(void)                     { }
+inline uint32_t gray_idle_time(void)            { return UINT32_MAX; }
+#endif
+
+#endif GRAYSCALE_H
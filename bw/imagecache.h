@@ -0,0 +1,32 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+imagecache.h - the display buffers of images drawn recently, to show them again without reading and
+decoding the file
+
+An image is found by its filename and told apart from a newer file of the same name by the size and the
+modification time of the file. When the cache is full, the image shown least recently is replaced. The
+budget is IMAGE_CACHE_SIZE bytes of RAM - or IMAGE_CACHE_PSRAM_SIZE, if the ESP32 has PSRAM (which is used
+then). It needs a display buffer to copy (see gfx_getBuffer()): without one, nothing is cached.
+
+*/
+
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+struct imageCacheKey
+{
+    char filename[MAX_FILENAME_LEN+1];
+    uint32_t hash;          // of the filename
+    uint32_t size, stamp;   // of the file: size, modification time
+    bool valid;             // the file exists
+};
+
+// copy the image to the display buffer (the caller shows it), if it is cached; key is set in any case
+bool image_cache_restore(const char *filename, struct imageCacheKey *key);
+void image_cache_store(const struct imageCacheKey *key);   // what the buffer holds (drawn completely!) is the image of key
+void image_cache_changed(void);     // files were changed or the drawing is another one: forget all - may be called by any task
+
+#endif IMAGECACHE_H
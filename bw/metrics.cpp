@@ -0,0 +1,276 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+metrics.cpp - timing and heap usage of drawing images and of the HTTP handlers, implementation
+
+The histograms have fixed buckets; a sample is counted in the first bucket whose upper bound it does not
+exceed (cumulated when printed, as Prometheus wants it). The HTTP handlers run in a task of their own,
+so updates and reading are done in (short) critical sections.
+
+The heap is checked before and after each drawing and handler. What they leave behind (a response still
+to be sent, a fragmented heap) shows as a "drop" of free heap or of the largest free block; the worst drop
+per handler/image type is kept, as the largest free block is what JPEG decoding and dithering need.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include "esplayer.h"
+#include "metrics.h"
+#include "log.h"
+
+#define METRIC_BUCKETS  8
+static const unsigned long bucket_bounds_us[METRIC_BUCKETS] = { 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000 };
+static const char *bucket_labels[METRIC_BUCKETS] = { "0.001", "0.005", "0.01", "0.05", "0.1", "0.5", "1", "5" };
+
+struct metricHistogram
+{
+    uint32_t buckets[METRIC_BUCKETS+1];     // the last one: above all bounds
+    uint32_t count;
+    uint64_t sum_us;
+};
+
+// the image types timed; index by metricType()
+#define METRIC_TYPES    2
+static const char *type_labels[METRIC_TYPES] = { "bmp", "jpeg" };
+static const char *stage_labels[STAGE_COUNT] = { "open", "header", "decode", "dither", "flush", "total" };
+static const char *handler_labels[HANDLER_COUNT] = { "root", "settings", "filesystem", "slideshow", "showwifi",
+                                                     "upload", "upload_tar", "upload_chunk", "metrics", "other" };
+
+static metricHistogram render_stages[METRIC_TYPES][STAGE_COUNT];
+static metricHistogram http_handlers[HANDLER_COUNT];
+
+struct metricHeapUse
+{
+    uint32_t count;
+    metricHeap before, after;       // of the last one
+    int32_t worst_free_drop;        // the largest decrease of the free heap (before - after)
+    int32_t worst_block_drop;       // the largest decrease of the largest free block
+    uint32_t min_block_after;       // the smallest "largest free block" seen afterwards
+};
+
+static metricHeapUse render_heap[METRIC_TYPES];
+static metricHeapUse http_heap[HANDLER_COUNT];
+static uint32_t heap_min_sampled = UINT32_MAX;     // the minimum of free heap seen here - for cores not tracking it
+
+// the drawing timed currently (drawing is done by loop() only)
+static struct
+{
+    int type;                               // -1: none
+    unsigned long start, lap;
+    metricHeap heap;                        // before
+    unsigned long stages_us[STAGE_COUNT];
+    bool passed[STAGE_COUNT];
+} render = { -1 };
+
+static int metricType(GFI_TYPE type)
+{
+    switch(type)
+    {
+    case GFI_TYPE_BMP:  return 0;
+    case GFI_TYPE_JPG:  return 1;
+    default:            return -1;
+    }
+}
+
+static void histogramAdd(metricHistogram *histogram, unsigned long duration_us)
+{
+    int bucket = 0;
+
+    while(bucket < METRIC_BUCKETS && duration_us > bucket_bounds_us[bucket])   ++bucket;
+    esp_enter_critical();
+    ++histogram->buckets[bucket];
+    ++histogram->count;
+    histogram->sum_us += duration_us;
+    esp_exit_critical();
+}
+
+metricHeap metrics_heap(void)
+{
+    metricHeap heap = { esp_heap_free(), esp_heap_largest_block() };
+    return heap;
+}
+
+static void heapUseAdd(metricHeapUse *use, const metricHeap &before)
+{
+    metricHeap after = metrics_heap();
+    int32_t free_drop  = (int32_t)before.free - (int32_t)after.free,
+            block_drop = (int32_t)before.largest_block - (int32_t)after.largest_block;
+
+    esp_enter_critical();
+    if(!use->count || free_drop > use->worst_free_drop)     use->worst_free_drop = free_drop;
+    if(!use->count || block_drop > use->worst_block_drop)   use->worst_block_drop = block_drop;
+    if(!use->count || after.largest_block < use->min_block_after)   use->min_block_after = after.largest_block;
+    ++use->count;
+    use->before = before;
+    use->after = after;
+    if(before.free < heap_min_sampled)  heap_min_sampled = before.free;
+    if(after.free < heap_min_sampled)   heap_min_sampled = after.free;
+    esp_exit_critical();
+}
+
+void metrics_render_begin(GFI_TYPE type)
+{
+    render.type = metricType(type);
+    render.heap = metrics_heap();
+    render.start = render.lap = micros();
+    memset(render.stages_us, 0, sizeof(render.stages_us));
+    memset(render.passed, 0, sizeof(render.passed));
+}
+
+void metrics_render_stage(METRIC_STAGE stage)
+{
+    unsigned long now;
+
+    if(render.type < 0) return;
+    now = micros();
+    render.stages_us[stage] += now - render.lap;    // unsigned arithmetic: correct across the overflow of micros()
+    render.passed[stage] = true;
+    render.lap = now;
+}
+
+void metrics_render_end(void)
+{
+    if(render.type < 0) return;
+    render.stages_us[STAGE_TOTAL] = micros() - render.start;
+    render.passed[STAGE_TOTAL] = true;
+    LOG_DEBUG("Total render time was %lu us", render.stages_us[STAGE_TOTAL]);
+    for(int stage = 0; stage < STAGE_COUNT; ++stage)
+        if(render.passed[stage])    histogramAdd(&render_stages[render.type][stage], render.stages_us[stage]);
+    heapUseAdd(&render_heap[render.type], render.heap);
+    render.type = -1;
+}
+
+void metrics_http(METRIC_HANDLER handler, unsigned long duration_us, const metricHeap &before)
+{
+    histogramAdd(&http_handlers[handler], duration_us);
+    heapUseAdd(&http_heap[handler], before);
+}
+
+// the minimum of free heap ever: by the core, if it knows
+static uint32_t heapMinFree(void)
+{
+    uint32_t min_free = esp_heap_min_free();
+    return (min_free || heap_min_sampled == UINT32_MAX) ? min_free : heap_min_sampled;
+}
+
+// print one histogram; labels is the part inside {} without le (may be empty)
+static void printHistogram(Print &out, const char *name, const String &labels, const metricHistogram *histogram)
+{
+    metricHistogram copy;
+    uint32_t cumulated = 0;
+    String separator = labels.length() ? "," : "";
+
+    esp_enter_critical();
+    copy = *histogram;
+    esp_exit_critical();
+
+    for(int bucket = 0; bucket <= METRIC_BUCKETS; ++bucket)
+    {
+        cumulated += copy.buckets[bucket];
+        out.print(String(name) + "_bucket{" + labels + separator + "le=\"" +
+                  ((bucket < METRIC_BUCKETS) ? bucket_labels[bucket] : "+Inf") + "\"} " + String((unsigned long)cumulated) + "\n");
+    }
+    out.print(String(name) + "_sum{" + labels + "} " + String((unsigned long)(copy.sum_us / 1000000)) + "." +
+              String((unsigned long)(copy.sum_us % 1000000 + 1000000)).substring(1) + "\n");
+    out.print(String(name) + "_count{" + labels + "} " + String((unsigned long)copy.count) + "\n");
+}
+
+void metrics_print(Print &out)
+{
+    out.print(F("# HELP tgd_uptime_seconds Time since the start.\n"
+                "# TYPE tgd_uptime_seconds gauge\n"));
+    out.print("tgd_uptime_seconds " + String(millis() / 1000) + "\n");
+
+    out.print(F("# HELP tgd_render_stage_seconds Time taken by the stages of drawing an image, by image type.\n"
+                "# TYPE tgd_render_stage_seconds histogram\n"));
+    for(int type = 0; type < METRIC_TYPES; ++type)
+        for(int stage = 0; stage < STAGE_COUNT; ++stage)
+            if(render_stages[type][stage].count || stage == STAGE_TOTAL)    // the stages a type does not pass are left out
+                printHistogram(out, "tgd_render_stage_seconds",
+                               String("type=\"") + type_labels[type] + "\",stage=\"" + stage_labels[stage] + "\"",
+                               &render_stages[type][stage]);
+
+    metricHeap heap = metrics_heap();
+    out.print(F("# HELP tgd_heap_free_bytes Free heap.\n"
+                "# TYPE tgd_heap_free_bytes gauge\n"));
+    out.print("tgd_heap_free_bytes " + String((unsigned long)heap.free) + "\n");
+    out.print(F("# HELP tgd_heap_min_free_bytes Minimum of free heap since the start.\n"
+                "# TYPE tgd_heap_min_free_bytes gauge\n"));
+    out.print("tgd_heap_min_free_bytes " + String((unsigned long)heapMinFree()) + "\n");
+    out.print(F("# HELP tgd_heap_largest_block_bytes Largest free block of the heap.\n"
+                "# TYPE tgd_heap_largest_block_bytes gauge\n"));
+    out.print("tgd_heap_largest_block_bytes " + String((unsigned long)heap.largest_block) + "\n");
+    out.print(F("# HELP tgd_heap_worst_block_drop_bytes Largest decrease of the largest free block by drawing an image or a handler.\n"
+                "# TYPE tgd_heap_worst_block_drop_bytes gauge\n"));
+    for(int type = 0; type < METRIC_TYPES; ++type)
+        if(render_heap[type].count)
+            out.print(String("tgd_heap_worst_block_drop_bytes{type=\"") + type_labels[type] + "\"} " + String((long)render_heap[type].worst_block_drop) + "\n");
+    for(int handler = 0; handler < HANDLER_COUNT; ++handler)
+        if(http_heap[handler].count)
+            out.print(String("tgd_heap_worst_block_drop_bytes{handler=\"") + handler_labels[handler] + "\"} " + String((long)http_heap[handler].worst_block_drop) + "\n");
+
+    out.print(F("# HELP tgd_http_handler_seconds Time taken by the HTTP handlers (the response is sent asynchronously afterwards).\n"
+                "# TYPE tgd_http_handler_seconds histogram\n"));
+    for(int handler = 0; handler < HANDLER_COUNT; ++handler)
+        printHistogram(out, "tgd_http_handler_seconds", String("handler=\"") + handler_labels[handler] + "\"",
+                       &http_handlers[handler]);
+}
+
+// one line of the heap report
+static void printHeapUse(Print &out, const char *kind, const char *label, const metricHeapUse *use)
+{
+    char line[120];
+    metricHeapUse copy;
+
+    esp_enter_critical();
+    copy = *use;
+    esp_exit_critical();
+    snprintf(line, sizeof(line), "%-6s %-13s %6lu %9lu %9lu %9lu %10ld %10ld %9ld\n", kind, label, (unsigned long)copy.count,
+             (unsigned long)copy.after.free, (unsigned long)copy.after.largest_block, (unsigned long)copy.min_block_after,
+             (long)copy.worst_free_drop, (long)copy.worst_block_drop, (long)copy.before.free - (long)copy.after.free);
+    out.print(line);
+}
+
+void metrics_heap_print(Print &out)
+{
+    metricHeap heap = metrics_heap();
+    struct { const char *kind, *label; int32_t drop; } worst[METRIC_TYPES+HANDLER_COUNT];
+    int worst_count = 0;
+
+    out.print("free heap:          " + String((unsigned long)heap.free) + " bytes\n");
+    out.print("minimum free heap:  " + String((unsigned long)heapMinFree()) + " bytes\n");
+    out.print("largest free block: " + String((unsigned long)heap.largest_block) + " bytes\n\n");
+
+    // per handler/image type: free heap and largest block after the last call, the smallest largest block after any,
+    // the worst drops of free heap and largest block, the drop of free heap by the last call
+    out.print(F("                      count     after     after  smallest      worst      worst      last\n"
+                "                                 free     block     block  free drop block drop free drop\n"));
+    for(int type = 0; type < METRIC_TYPES; ++type)
+        if(render_heap[type].count)
+        {
+            printHeapUse(out, "render", type_labels[type], &render_heap[type]);
+            worst[worst_count++] = { "render", type_labels[type], render_heap[type].worst_block_drop };
+        }
+    for(int handler = 0; handler < HANDLER_COUNT; ++handler)
+        if(http_heap[handler].count)
+        {
+            printHeapUse(out, "http", handler_labels[handler], &http_heap[handler]);
+            worst[worst_count++] = { "http", handler_labels[handler], http_heap[handler].worst_block_drop };
+        }
+
+    // the worst offenders: sorted by the drop of the largest free block (a few entries, simple insertion sort)
+    for(int i = 1; i < worst_count; ++i)
+        for(int j = i; j > 0 && worst[j].drop > worst[j-1].drop; --j)
+        {
+            auto h = worst[j];
+            worst[j] = worst[j-1];
+            worst[j-1] = h;
+        }
+    out.print(F("\nworst offenders (largest drop of the largest free block):\n"));
+    for(int i = 0; i < worst_count && i < 5 && worst[i].drop > 0; ++i)
+        out.print(String(i+1) + ". " + worst[i].kind + " " + worst[i].label + ": " + String((long)worst[i].drop) + " bytes\n");
+}
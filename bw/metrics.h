@@ -0,0 +1,54 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+metrics.h - timing and heap usage of drawing images and of the HTTP handlers, exported in Prometheus text
+format (/metrics) and as a human readable heap report (/heap)
+
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "gfxsniff.h"
+
+// the stages of drawing an image; the time between two calls of metrics_render_stage() is added to the later one
+enum METRIC_STAGE
+{
+    STAGE_OPEN,     // opening the file
+    STAGE_HEADER,   // reading and checking the header (JPEG: initializing the decoder)
+    STAGE_DECODE,   // reading the pixels (BMP: including dithering and drawing) / decoding the MCUs
+    STAGE_DITHER,   // dithering and drawing the decoded image (bw JPEG)
+    STAGE_FLUSH,    // writing the buffer to the display
+    STAGE_TOTAL,    // all of it - recorded by metrics_render_end()
+    STAGE_COUNT
+};
+
+// the HTTP handlers metered (see InitializeHTTPServer())
+enum METRIC_HANDLER
+{
+    HANDLER_ROOT, HANDLER_SETTINGS, HANDLER_FILESYSTEM, HANDLER_SLIDESHOW, HANDLER_SHOWWIFI,
+    HANDLER_UPLOAD, HANDLER_UPLOAD_TAR, HANDLER_UPLOAD_CHUNK, HANDLER_METRICS, HANDLER_OTHER,
+    HANDLER_COUNT
+};
+
+// the state of the heap, before and after drawing or a handler
+struct metricHeap
+{
+    uint32_t free;
+    uint32_t largest_block;     // the largest allocation possible - fragmentation makes it smaller than free
+};
+
+metricHeap metrics_heap(void);              // the state now
+
+void metrics_render_begin(GFI_TYPE type);   // start timing the drawing of an image
+void metrics_render_stage(METRIC_STAGE stage);  // a stage is done; ignored if no drawing is timed
+void metrics_render_end(void);              // record the stages passed, the total time and the heap
+
+void metrics_http(METRIC_HANDLER handler, unsigned long duration_us, const metricHeap &before);   // count a request, with the time the handler took and the heap before
+
+void metrics_print(Print &out);             // all metrics, Prometheus text format
+void metrics_heap_print(Print &out);        // the heap now and per handler/image type, the worst offenders first
+
+#endif METRICS_H
@@ -32,32 +32,37 @@ extern WEBSERVER_CLASS server;      // Web server
 // Conmmon Paramenters
 extern bool SoftAccOK;
 
-// buffer of filenames for the pictures available for the slideshow
-extern int slideshow_num_images;
-extern char slideshow_filenames[SLIDESHOW_MAX_IMAGES][MAX_FILENAME_LEN+1];
-
 void InitializeHTTPServer(void);
 boolean CreateWifiSoftAP(void);
 byte ConnectWifiAP(void);
 
 char *urlencode(char const *from);      // mask special characters, returning a pseudo-copy - in fact, to a static buffer...
 
-// create/update the "index" of images that may be displayed - to be used in the slideshow
-// in fact, this is a stripped down version of handleRoot()
-// updates the global vars slideshow_filenames[] and slideshow_num_images
+// (re)build the index of images that may be displayed (see imageindex.h) - to be used by the listing and the slideshow
 void scan_images_for_slideshow(void);
 
-void handleFileUpload(void);            // upload a new file to the SPIFFS
-void handleDisplayFS(void);
-void handleRoot(void);
-void handleNotFound(void);
-void handleSettings(void);              // settings page handler
-void handleUploadSave(void);
-void handleSlideshow(void);
-void handleShowWifi(void);
-bool handleFileRead(String path);       // send the right file to the client (if it exists)
-
-boolean captivePortal(void);            // Redirect to captive portal if we got a request for another domain. Return true in that case so the page handler do not try to handle the request again.
+// the HTTP handlers are called asynchronously (see processNetworkActions())
+void handleFileUpload(AsyncWebServerRequest *request, const String &upload_filename, size_t index, uint8_t *data, size_t len, bool final);  // upload a new file to the filesystem
+void handleUploadDone(AsyncWebServerRequest *request);  // response to the upload, after handleFileUpload() is done
+void handleTarBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);   // unpack a tar archive sent as raw body
+void handleTarUpload(AsyncWebServerRequest *request, const String &upload_filename, size_t index, uint8_t *data, size_t len, bool final);  // unpack a tar archive sent as form upload
+void handleTarDone(AsyncWebServerRequest *request);     // response to the archive upload
+void handleChunkBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);  // append a piece of a resumable upload
+void handleChunkDone(AsyncWebServerRequest *request);   // response to a piece of a resumable upload / query of its state
+void handleDisplayFS(AsyncWebServerRequest *request);
+void handleRoot(AsyncWebServerRequest *request);
+void handleNotFound(AsyncWebServerRequest *request);
+void handleSettings(AsyncWebServerRequest *request);    // settings page handler
+void handleSlideshow(AsyncWebServerRequest *request);
+void handleShowWifi(AsyncWebServerRequest *request);
+bool handleFileRead(AsyncWebServerRequest *request, String path);   // send the right file to the client (if it exists)
+void handleMetrics(AsyncWebServerRequest *request);     // timing of drawing and of the handlers, Prometheus text format
+void handleHeap(AsyncWebServerRequest *request);        // heap report: now, per handler and image type
+void handleLog(AsyncWebServerRequest *request);         // the recent diagnostic messages
+
+boolean captivePortal(AsyncWebServerRequest *request);  // Redirect to captive portal if we got a request for another domain. Return true in that case so the page handler do not try to handle the request again.
+
+void processNetworkActions(void);       // do the (slow) things the HTTP handlers ordered - to be called from loop()
 
 void doShowWifi(bool force);
 
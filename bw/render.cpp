@@ -0,0 +1,305 @@
+/*
+
+Tobis General Display
+by Arnold Schommer, Tobias Kuch
+
+render.cpp - drawing image files from the filesystem on the display: what depends on the display (see rendercore.h), u8g2 variant
+
+taken out of bw.ino to be compilable without the rest of the sketch (see host/)
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include "esplayer.h"
+#include <U8g2lib.h>        // https://github.com/olikraus/u8g2
+extern U8G2_DECLARATION;
+#include "gfxlayer.h"
+#include "render.h"
+#include "grayscale.h"
+#include "metrics.h"
+#include "log.h"
+
+//#############################################################################
+// JPEG support framework
+// Bodmers JPEG lib is optimized for low memory usage, which makes sense for
+// Arduino but has the disadvantage that it draws the image tile by tile -
+// making Floyd-Steinberg-dithering (almost) impossible.
+// I add another "Framebuffer" to change the render process:
+// first, Bodmers jpeg lib writes to a framebuffer via repeated drawRGBBitmap()
+// then the whole framebuffer is converted to a b/w image, doing Floyd-
+// Steinberg-dithering on the fly.
+// in fact, the framebuffer does not hold the colors as given by the jpeg
+// output but int8_t's of the added luminances (i.e. 0...3*255 scaled down to
+// 0..127).
+// (scaling fown from int16_t to int8_t is not really necessary concerning
+//  memory consumption, but i see no relevant quality drawback on the way to
+//  1bit resullts and shrinking the buffer should gain performance by better
+//  caching effects)
+// there are three (main) procedures:
+// prepare_framebuffer()
+//          takes a framebuffer from the scratch memory (render_arena_begin())
+//          and clears it; it is sized for the full display, the part shown
+//          of an image never is larger
+// drawRGBTile()
+//          "paints" a rectangle given as an RGB565-array to a certain
+//          location within the framebuffer
+// framebuffer_to_display()
+//          "paints" the framebuffer content to the SSD1306, applying
+//          Floyd-Steinberg-dithering
+
+// define a "scaling" factor for Floyd-Steinberg-dithering (must be <128! )
+#define FS_SCALE_MAX    100
+/* problem: if e.g. the colours range from 0-127, intermediate values (with
+    error coefficients) can easily exceed 127 (by an amount i do not know).
+    But if i use int8_t as datatype, this causes "overflows" like
+    127+2 "=" -127.
+    To prevent this, i use some "safety reserve"
+    Further, to make the threshold more symmetric, this value should
+    preferrably be even.
+*/
+
+// the dithering sets a pixel to the level nearest to value (0..max) and returns that level (0..max), the
+// difference is the error to be propagated: black or white - or, drawing in gray levels, 4 of them
+static inline int16_t render_dot(uint16_t x, uint16_t y, int16_t value, int16_t max, bool gray)
+{
+    if(gray)
+    {
+        int16_t level = (value <= 0) ? 0 : (value >= max) ? GRAY_LEVELS-1 : (value*(GRAY_LEVELS-1) + max/2) / max;
+
+        if(level & 2)   gfx_setPixel(x, y);     // the high bit: shown twice as long as the low one
+        if(level & 1)   gray_setPixel(x, y);
+        return level * max / (GRAY_LEVELS-1);
+    }
+    if(value > max/2)
+    {
+        gfx_setPixel(x, y);
+        return max;
+    }
+    return 0;
+}
+
+static int8_t *fb;
+// used like fb[gfx_getScreenHeight()][gfx_getScreenWidth()]
+// reason for this strange (logic) organization:
+// i want to keep adjacent x-values adjacent, not adjacent y-values as
+// the dithering walks throuh it line by line, columns iterated in "the inner" loop
+static struct renderView fb_view;   // the part of the image held in the framebuffer (fb[0] is pixel x0,y0)
+
+bool prepare_framebuffer(const uint16_t width, const uint16_t height)
+// width & height: concerning the image, not the framebuffer
+{
+    if(!render_view(width, height, &fb_view))   fb_view.x1 = fb_view.x0, fb_view.y1 = fb_view.y0;   // nothing to be shown
+    render_arena_reset();   // (the first buffer of a JPEG image)
+    fb = (int8_t *)render_arena_alloc(gfx_getScreenWidth()*gfx_getScreenHeight()*sizeof(*fb));
+    if(!fb)
+    {
+        LOG_ERROR("can't alloc framebuffer, %u bytes unavailable", (unsigned)(gfx_getScreenWidth()*gfx_getScreenHeight()*sizeof(*fb)));
+        return false;
+    }
+    // clear the relevant number of rows, all columns (reducing the columns might save some writes but require a loop...)
+    memset((void *)fb, 0, (fb_view.y1 - fb_view.y0) * gfx_getScreenWidth() * sizeof(*fb));
+    return true;
+}
+
+//#############################################################################
+// draw a tile already loaded to a small memory buffer - called/required by jpegRender()
+// converting from RGB565 to grayscale, 0..FS_SCALE_MAX (int8_t)
+// x, y: within the image; what is not shown (see prepare_framebuffer()) is skipped
+// CAUTION: will crash, if prepare_framebuffer() is not yet called (successfully) !
+void drawRGBTile(uint16_t x, uint16_t y, uint16_t *pImg, uint16_t width, uint16_t height)
+{
+    // Serial.println("drawRGBTile("+String(x)+", "+String(y)+", *pImg, "+String(width)+", "+String(height)+")");
+    // the columns of the tile shown: cx_begin..cx_end-1 - clipped once, not per pixel
+    uint16_t cx_begin = (x < fb_view.x0) ? fb_view.x0 - x : 0,
+             cx_end   = (x + width <= fb_view.x1) ? width : (x < fb_view.x1) ? fb_view.x1 - x : 0;
+
+    for(; height > 0; ++y, --height, pImg += width)
+    {
+        int8_t *fb_line;
+
+        if(y >= fb_view.y1)  return; // abort if the part shown is left
+        if(y < fb_view.y0)   continue;
+
+        fb_line = fb + (y-fb_view.y0)*gfx_getScreenWidth() + x - fb_view.x0;     // (a constant width: see DISPLAY_WIDTH)
+        for(uint16_t cx = cx_begin; cx < cx_end; ++cx)
+        {   // sum up the rgb parts of the RGB565-value to one value:
+            int16_t brightness = ((pImg[cx] >> 8) & 0xf8) +  // r
+                                 ((pImg[cx] >> 3) & 0xfc) +  // g
+                                 ((pImg[cx] << 3) & 0xf8);   // b
+            // save the "result", mapped to 0..FS_SCALE_MAX (like map(), but with constants only)
+            fb_line[cx] = brightness * FS_SCALE_MAX / (0xf8+0xfc+0xf8);
+                // 0xf8+0xfc+0xf8: you might expect the maximum of the brightness from r+g+b (8bit) to be 255,
+                // but the values are RGB565, not RGB888, and RGB565 allows maxima of 0xf8/0xfc/0xf8.
+        }
+    }
+}
+
+// "paint" the framebuffer content to the SSD1306, applying
+// Floyd-Steinberg-dithering
+// width & height: concerning the image; the framebuffer holds the part shown only
+void framebuffer_to_display(uint16_t width, uint16_t height)
+{
+    int8_t *fsd_error_buffer,               // buffer for the error coefficients of Floyd-Steinberg-dithering, (approximately) two lines only!
+           *fsd_this_line, *fsd_next_line;  // these switch between first and second "half"/line of fsd_error_buffer
+    uint16_t fb_width  = fb_view.x1 - fb_view.x0,
+             fb_height = fb_view.y1 - fb_view.y0;
+    int32_t offset_x = fb_view.x0 + fb_view.offset_x,
+            offset_y = fb_view.y0 + fb_view.offset_y;
+#define FSD_LINESIZE    ((fb_width)+2)
+#define FSD_INDEX(x)    ((x)+1)
+
+    // prepare a buffer of two lines plus(!) two "pixels" each for error coefficients of Floyd-Steinberg-dithering
+    fsd_error_buffer = (int8_t *) render_arena_alloc(2*FSD_LINESIZE*sizeof(*fsd_error_buffer));
+    if(!fsd_error_buffer)
+    {
+        LOG_ERROR("can't alloc buffer(s) for Floyd-Steinberg-dithering, %u bytes unavailable; aborting drawing", (unsigned)(2*FSD_LINESIZE*sizeof(*fsd_error_buffer)));
+        return;
+    }
+    // Serial.println(String(2*FSD_LINESIZE*sizeof(*fsd_error_buffer))+" bytes of buffer(s) for Floyd-Steinberg-dithering allocated");
+    memset(fsd_error_buffer, 0, 2*FSD_LINESIZE*sizeof(*fsd_error_buffer));
+    fsd_this_line = fsd_error_buffer;
+    fsd_next_line = fsd_error_buffer+FSD_LINESIZE;
+
+    gfx_clearBuffer();
+    bool gray = gray_begin();
+    for (uint16_t row = 0; row < fb_height; row++) // for each line
+    {
+        // swap lines concerning Floyd-Steinberg buffer; clear next line
+        if(row>0)
+        {
+            int8_t *h;
+            h=fsd_this_line;
+            fsd_this_line=fsd_next_line;
+            fsd_next_line=h;
+            // clear next line error buffer
+            memset(fsd_next_line, 0, FSD_LINESIZE*sizeof(*fsd_error_buffer));
+        }
+
+        const int8_t *fb_line = fb + row*gfx_getScreenWidth();
+        for (uint16_t col = 0; col < fb_width; col++) // for each pixel
+        {
+            int8_t setpoint = fb_line[col] + fsd_this_line[FSD_INDEX(col)],
+                   real = render_dot(col+offset_x, row+offset_y, setpoint, FS_SCALE_MAX, gray),
+                   qerror = setpoint - real;
+            // propagate quantization error accodring to Floyd-Steinberg:
+            fsd_this_line[FSD_INDEX(col+1)] += qerror*7/16;
+            fsd_next_line[FSD_INDEX(col-1)] += qerror*3/16;
+            fsd_next_line[FSD_INDEX(col  )] += qerror*5/16;
+            fsd_next_line[FSD_INDEX(col+1)] += qerror  /16;
+        } // end pixel
+      } // end line
+    metrics_render_stage(STAGE_DITHER);
+    render_flush(); // Show results :)
+    metrics_render_stage(STAGE_FLUSH);
+}
+
+// end of JPEG support framework
+//#############################################################################
+
+size_t render_arena_needed(void)
+{   // JPEG: the framebuffer and the dithering lines; BMP: a row read and the dithering lines (bytes: int16_t)
+    size_t w = gfx_getScreenWidth(), h = gfx_getScreenHeight();
+
+    return w*h + 2*(w+2) + 3*(w+8) + 2*2*(w+2);
+}
+
+void drawBitmap_SPIFFS(const char *filename)
+{
+  struct bmpImage bmp;
+  int16_t *fsd_error_buffer = NULL,         // buffer for the error coefficients of Floyd-Steinberg-dithering, (approximately) two lines only!
+          *fsd_this_line = NULL, *fsd_next_line = NULL;  // these switch between first and second "half"/line of fsd_error_buffer
+  uint8_t inverter = 0;
+  const uint8_t *data;
+  bool complete = true;     // every row was read
+
+  if(!bmp_open(filename, &bmp)) return;
+#undef FSD_LINESIZE
+#undef FSD_INDEX
+#define FSD_LINESIZE    ((bmp.view.x1-bmp.x0)+2)
+#define FSD_INDEX(x)    ((x)-bmp.x0+1)
+  // reason for "+1": the dithering will always "postpone" a part of the error to the some pixels left and right of the current one -
+  // i do not deal with the edges, i just make them "part of what is buffered" to prevent buffer overflows etc. but never read from them.
+
+  if(bmp.depth == 24)
+  {   // prepare a buffer of two lines plus(!) two "pixels" each for error coefficients of Floyd-Steinberg-dithering
+      fsd_error_buffer = (int16_t *) render_arena_alloc(2*FSD_LINESIZE*sizeof(*fsd_error_buffer));
+      if(!fsd_error_buffer)
+      {
+          LOG_ERROR("can't alloc buffer(s) for Floyd-Steinberg-dithering, %u bytes unavailable; aborting drawing of %s", (unsigned)(2*FSD_LINESIZE*sizeof(*fsd_error_buffer)), filename);
+          bmp_close(&bmp);
+          return;
+      }
+      // Serial.println(String(2*FSD_LINESIZE*sizeof(*fsd_error_buffer))+" bytes of buffer(s) for Floyd-Steinberg-dithering allocated");
+      memset(fsd_error_buffer, 0, 2*FSD_LINESIZE*sizeof(*fsd_error_buffer));
+      fsd_this_line = fsd_error_buffer;
+      fsd_next_line = fsd_error_buffer+FSD_LINESIZE;
+  }
+  else
+  {   // depending on which palette color is lighter, this "becomes" white on the display:
+      inverter = (bmp.palette[0][0] + bmp.palette[0][1] + bmp.palette[0][2] >
+                  bmp.palette[1][0] + bmp.palette[1][1] + bmp.palette[1][2]) ? ~0 : 0;
+  }
+  metrics_render_stage(STAGE_HEADER);
+  gfx_clearBuffer();
+  bool gray = gray_begin();
+  for (uint16_t row = bmp.view.y0; row < bmp.view.y1; row++) // for each line
+  {
+    if(!(data = bmp_read_row(&bmp, row)))
+    {
+        LOG_ERROR("Err: BMP %s: can't read row %u", filename, row);
+        complete = false;
+        break;
+    }
+    // swap lines concerning Floyd-Steinberg buffer; clear next line
+    if((bmp.depth == 24) && (row>bmp.view.y0))
+    {
+        int16_t *h;
+        h=fsd_this_line;
+        fsd_this_line=fsd_next_line;
+        fsd_next_line=h;
+        // clear next line error buffer
+        memset(fsd_next_line, 0, FSD_LINESIZE*sizeof(*fsd_error_buffer));
+    }
+
+    uint8_t bits = 0;
+    for (uint16_t col = bmp.x0; col < bmp.view.x1; col++) // for each pixel
+    {
+      switch (bmp.depth)
+      {
+        case 1: // one bit per pixel b/w format
+          {
+            if (0 == col % 8)
+                bits = *data++ ^ inverter;
+            if((bits & 0x80) && (col >= bmp.view.x0))
+            {
+                gfx_setPixel(col+bmp.view.offset_x, row+bmp.view.offset_y);
+                if(gray)    gray_setPixel(col+bmp.view.offset_x, row+bmp.view.offset_y);    // (white: both planes)
+            }
+            bits <<= 1;
+          }
+          break;
+        case 24: // standard BMP format
+          {
+            int16_t b = (int16_t)*data++,
+                    g = (int16_t)*data++,
+                    r = (int16_t)*data++,
+                    setpoint = r+b+g+fsd_this_line[FSD_INDEX(col)],
+                    real = render_dot(col+bmp.view.offset_x, row+bmp.view.offset_y, setpoint, 255*3, gray),
+                    qerror = setpoint - real;
+            // propagate quantization error accodring to Floyd-Steinberg:
+            fsd_this_line[FSD_INDEX(col+1)] += qerror*7/16;
+            fsd_next_line[FSD_INDEX(col-1)] += qerror*3/16;
+            fsd_next_line[FSD_INDEX(col  )] += qerror*5/16;
+            fsd_next_line[FSD_INDEX(col+1)] += qerror  /16;
+          }
+          break;
+      }
+    } // end pixel
+  } // end line
+  metrics_render_stage(STAGE_DECODE);
+  render_flush(complete); // Show results :)
+  metrics_render_stage(STAGE_FLUSH);
+  bmp_close(&bmp);
+}
@@ -0,0 +1,26 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+render.h - drawing image files from the filesystem on the display (render.cpp, JPEG_functions.cpp), u8g2 variant
+
+*/
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "rendercore.h"     // (what both variants share)
+
+void drawBitmap_SPIFFS(const char *filename);
+void drawJpeg_SPIFFS(const char *filename);
+
+// JPEG support framework: the tiles are collected in a framebuffer to be dithered as a whole
+bool prepare_framebuffer(const uint16_t width, const uint16_t height);
+void drawRGBTile(uint16_t x, uint16_t y, uint16_t *pImg, uint16_t width, uint16_t height);
+void framebuffer_to_display(uint16_t width, uint16_t height);
+
+void jpegRender(int xpos, int ypos);
+void jpegInfo(void);
+
+#endif RENDER_H
@@ -0,0 +1,60 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+rendercore.h - the part of drawing that does not depend on the display: choosing the decoder, the part of an
+image shown (video wall), the scratch memory and reading BMP files
+
+render.cpp of each variant just turns the pixels into what its display takes (dithered black&white, RGB
+colors); everything else is done here, the same for both variants - so it is optimized once.
+
+*/
+
+#ifndef RENDERCORE_H
+#define RENDERCORE_H
+
+#include "bitmap.h"
+
+// draw any supported image file, the type is determined by the filename extension;
+// flush false: it is drawn to the buffer only, the caller shows it by gfx_flushBuffer() (when it is time to)
+void drawAnyImageType(const char *filename, bool flush = true);
+void render_flush(bool complete = true);   // the drawing is done: show it - unless drawAnyImageType() was told not to;
+                                            // not complete (a read error): shown as far as it got, but not cached
+
+// video wall: the image is centered on a grid of cols*rows displays, this one being at col,row (0,0: top left);
+// each display reads and draws its part only. 1,1,0,0: a single display (the default)
+void render_set_wall(uint8_t cols, uint8_t rows, uint8_t col, uint8_t row);
+struct renderView
+{
+    uint16_t x0, y0, x1, y1;        // the part of the image shown: x0 <= x < x1, y0 <= y < y1
+    int32_t offset_x, offset_y;     // screen position = image position + offset
+};
+bool render_view(uint32_t width, uint32_t height, struct renderView *view);    // false: nothing of the image is shown
+bool render_fits(uint32_t width, uint32_t height);     // can an image of that size be shown (on the whole wall)?
+
+// the buffers needed while drawing are taken from scratch memory reserved once (from PSRAM, if there is
+// any), not from the heap: call this early, before the heap is fragmented (else it is done when drawing first)
+bool render_arena_begin(void);
+void render_arena_reset(void);              // a new image: all buffers are free again
+void *render_arena_alloc(size_t size);      // NULL: not enough left (not cleared!)
+size_t render_arena_needed(void);           // bytes the variant needs at most per image (render.cpp)
+
+// BMP files (uncompressed, 1 or 24 bits per pixel), read row by row - just the part shown
+struct bmpImage
+{
+    File file;
+    uint32_t width, height;
+    uint16_t depth;                 // bits per pixel
+    uint32_t offset, row_size;      // of the image data: where it starts, bytes per row (padded to 4 bytes)
+    bool top_down;                  // (usually, the bottom row comes first)
+    uint8_t palette[2][3];          // depth 1: red, green, blue of the bits 0 and 1
+    struct renderView view;         // (nothing shown: y0 == y1)
+    uint16_t x0;                    // the first column read: view.x0, for depth 1 rounded down to a byte
+    uint8_t *row;                   // the buffer of bmp_read_row() (scratch memory)
+};
+bool bmp_open(const char *filename, struct bmpImage *bmp);      // false: no BMP to be drawn (logged)
+const uint8_t *bmp_read_row(struct bmpImage *bmp, uint16_t y);  // columns x0..view.x1-1 of row y; NULL: read error
+void bmp_close(struct bmpImage *bmp);
+
+#endif RENDERCORE_H
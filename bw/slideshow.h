@@ -0,0 +1,45 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+slideshow.h - showing the images one after another: all images of the index or those of a playlist
+
+The slides are switched at absolute deadlines - the next one is the previous one plus the duration of
+the slide - so the time drawing takes does not add up. All time arithmetic is done on differences,
+which stay right when millis() wraps around (after 49.7 days).
+
+A playlist is a text file on the filesystem with one image per line, optionally followed by how long
+(ms) it is to be shown; empty lines and lines starting with # are ignored:
+
+    # the logo for ten seconds, then the photo for the default time (SLIDESHOW_PERIOD)
+    /logo.bmp 10000
+    /photo.jpg
+
+*/
+
+#ifndef SLIDESHOW_H
+#define SLIDESHOW_H
+
+#define SLIDESHOW_PLAYLIST_EXT  ".lst"      // how the file manager tells playlists from other files
+
+// has deadline been reached at now? (correct across the wraparound, as long as both are less than 24.8 days apart)
+inline bool time_reached(uint32_t now, uint32_t deadline) { return (int32_t)(now - deadline) >= 0; }
+
+// the HTTP handlers may start and stop the slideshow; the change is done by slideshow_loop()
+void slideshow_start(const char *playlist); // NULL or "": SLIDESHOW_DEFAULT_PLAYLIST if it exists, all images otherwise
+void slideshow_stop(void);
+bool slideshow_running(void);
+bool slideshow_is_playlist(const char *filename);
+
+void slideshow_suspend(void);   // the current slide (e.g. the WiFi info) stays for SLIDESHOW_PERIOD from now on
+void slideshow_drawn_over(void);    // something else was drawn: a slide drawn ahead has to be drawn again - from loop() only
+bool slideshow_loop(void);      // draw the next slide if it is due (=> true) - to be called from loop()
+uint32_t slideshow_idle_time(void);     // ms until slideshow_loop() has something to do (UINT32_MAX: nothing)
+
+// synchronized slideshows (see sync.h): the leader announces its next slide, the followers show it at the same time
+bool slideshow_next_slide(char *filename, uint32_t *deadline);  // false: none known (yet)
+void slideshow_follow(const char *filename, uint32_t deadline); // show filename at deadline (local time) - from loop() only
+void slideshow_unfollow(void);  // no leader any more: a slideshow following continues on its own - from loop() only
+
+#endif SLIDESHOW_H
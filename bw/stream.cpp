@@ -0,0 +1,307 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+stream.cpp - live frames, implementation, u8g2 variant
+
+The WebSocket handler runs asynchronously (ESP32: in the task of the TCP stack), so it just queues the
+packets; stream_loop() decodes them - UDP packets it reads itself. The frames are written to the u8g2
+buffer in place (an XOR frame applied to what it holds), and only the tiles changed are sent to the display.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include "esplayer.h"
+#include <U8g2lib.h>        // https://github.com/olikraus/u8g2
+extern U8G2_DECLARATION;
+#include "gfxlayer.h"
+#include "slideshow.h"
+#include "stream.h"
+#include "log.h"
+
+#define STREAM_MAGIC            'F'
+#define STREAM_XOR              1
+#define STREAM_RLE              2
+#define STREAM_END              128
+
+#define STREAM_POLL_ACTIVE      2       // ms between looking for UDP packets while frames come in (otherwise: when loop() wakes)
+#define STREAM_TIMEOUT          1000    // ms without a packet: the stream is over
+
+struct streamHeader
+{
+    uint8_t magic;
+    uint8_t flags;
+    uint16_t frame;
+    uint32_t offset;
+} __attribute__((packed));
+
+static WiFiUDP stream_udp;
+static AsyncWebSocket stream_ws("/stream");
+
+// WebSocket packets, queued by the handler for stream_loop(): 2 bytes length, the packet
+static uint8_t stream_queue[STREAM_QUEUE_SIZE];
+static size_t queue_head = 0, queue_tail = 0;   // where to write / read next; equal: empty
+static uint8_t ws_message[STREAM_PACKET_MAX];   // a message arriving in several parts is collected here
+static uint32_t ws_client = 0;                  // (the client sending it)
+
+// used by loop() only
+static bool stream_active = false;      // packets came in within STREAM_TIMEOUT
+static uint32_t stream_last_packet;     // millis()
+static bool stream_base = false;        // the display shows frame stream_last_frame completely: an XOR frame may follow
+static uint16_t stream_last_frame;
+static struct
+{
+    bool open;                          // packets of it arrived, the last one not yet
+    uint16_t number;
+    uint32_t position;                  // the offset the next packet should have
+    bool complete;                      // no packet missing so far
+    bool skip;                          // an XOR frame without its base
+    uint16_t x0, x1, page0, page1;      // the part changed: columns x0..x1, pages (8 rows) page0..page1
+} frame;
+
+//#############################################################################
+// writing the frame: u8g2 variant
+
+static uint8_t *frame_buffer;
+static uint32_t frame_size, frame_line;     // bytes of the buffer, of a page (8 rows)
+
+static void frame_begin(void)
+{
+    frame_buffer = gfx_getBuffer();
+    frame_size = gfx_getBufferSize();
+    frame_line = frame_size / ((gfx_getScreenHeight() + 7) / 8);
+    frame.x0 = frame.page0 = UINT16_MAX;
+    frame.x1 = frame.page1 = 0;
+    if(!stream_base)    // the buffer may hold something else than the display shows: send it all
+    {
+        frame.x0 = frame.page0 = 0;
+        frame.x1 = frame_line - 1;
+        frame.page1 = frame_size / frame_line - 1;
+    }
+}
+
+static inline void frame_put(uint32_t pos, uint8_t value, bool xor_it)
+{
+    uint16_t x, page;
+
+    if(pos >= frame_size)   return;
+    if(xor_it)  value ^= frame_buffer[pos];
+    if(value == frame_buffer[pos])  return;
+    frame_buffer[pos] = value;
+    x = pos % frame_line;
+    page = pos / frame_line;
+    if(x < frame.x0)    frame.x0 = x;
+    if(x > frame.x1)    frame.x1 = x;
+    if(page < frame.page0)  frame.page0 = page;
+    if(page > frame.page1)  frame.page1 = page;
+}
+
+static bool frame_show(void)       // true: an XOR frame may follow
+{
+    if(frame.x0 <= frame.x1)    // (else nothing changed)
+        gfx_flushArea(frame.x0, frame.page0 * 8, frame.x1 - frame.x0 + 1, (frame.page1 - frame.page0 + 1) * 8);
+    return true;
+}
+
+static void frame_release(void)     // (the u8g2 buffer stays)
+{
+}
+
+static void stream_describe(AsyncWebSocketClient *client)
+{
+    client->text(String(gfx_getScreenWidth()) + "x" + String(gfx_getScreenHeight()) + " page1");
+}
+
+//#############################################################################
+
+// decode the payload of a packet into the frame, from offset on; returns the number of bytes decoded
+static uint32_t stream_decode(uint32_t offset, const uint8_t *data, size_t len, uint8_t flags)
+{
+    uint32_t pos = offset;
+    bool xor_it = flags & STREAM_XOR;
+
+    if(!(flags & STREAM_RLE))
+    {
+        while(len--)    frame_put(pos++, *data++, xor_it);
+        return pos - offset;
+    }
+    // PackBits: n = 0..127: n+1 bytes follow as they are; n = -1..-127: the next byte 1-n times; -128: nothing
+    while(len)
+    {
+        int8_t n = (int8_t)*data++;
+        int count;
+
+        len--;
+        if(n >= 0)
+        {
+            for(count = n+1; count && len; count--, len--)  frame_put(pos++, *data++, xor_it);
+        }
+        else if((n != -128) && len)
+        {
+            for(count = 1-n; count; count--)    frame_put(pos++, *data, xor_it);
+            data++; len--;
+        }
+    }
+    return pos - offset;
+}
+
+static void stream_packet(const uint8_t *data, size_t len)
+{
+    struct streamHeader header;
+
+    if(len < sizeof(header))    return;
+    memcpy(&header, data, sizeof(header));
+    if(header.magic != STREAM_MAGIC)    return;
+    data += sizeof(header);
+    len -= sizeof(header);
+
+    stream_last_packet = millis();
+    if(!stream_active)
+    {
+        LOG_INFO("stream: receiving frames");
+        stream_active = true;
+        if(slideshow_running()) slideshow_stop();
+    }
+    if(!frame.open || (header.frame != frame.number))   // a new frame
+    {
+        if(frame.open)  stream_base = false;    // the one before is incomplete
+        frame.open = true;
+        frame.number = header.frame;
+        frame.position = 0;
+        frame.complete = true;
+        frame.skip = (header.flags & STREAM_XOR) && !(stream_base && (header.frame == (uint16_t)(stream_last_frame + 1)));
+        if(frame.skip)  LOG_DEBUG("stream: XOR frame %u without its base, skipped", header.frame);
+        else
+        {
+            frame_begin();
+            slideshow_drawn_over(); // (a follower may get the next slide while frames come in)
+        }
+    }
+    if(header.offset != frame.position) frame.complete = false;
+    if(!frame.skip) frame.position = header.offset + stream_decode(header.offset, data, len, header.flags);
+
+    if(header.flags & STREAM_END)
+    {
+        frame.open = false;
+        if(frame.skip)  return;
+        stream_base = frame_show() && frame.complete;
+        stream_last_frame = frame.number;
+    }
+}
+
+void stream_invalidate(void)
+{
+    stream_base = false;
+    frame.open = false;
+}
+
+//#############################################################################
+// WebSocket: just queue the packets
+
+static void ring_write(const uint8_t *data, size_t len)
+{
+    while(len--)
+    {
+        stream_queue[queue_head] = *data++;
+        queue_head = (queue_head + 1) % STREAM_QUEUE_SIZE;
+    }
+}
+
+static void ring_read(uint8_t *data, size_t len)
+{
+    while(len--)
+    {
+        *data++ = stream_queue[queue_tail];
+        queue_tail = (queue_tail + 1) % STREAM_QUEUE_SIZE;
+    }
+}
+
+static void stream_queue_put(const uint8_t *data, size_t len)
+{
+    uint8_t length[2] = { (uint8_t)len, (uint8_t)(len >> 8) };
+    bool fits;
+
+    esp_enter_critical();
+    fits = (queue_head - queue_tail + STREAM_QUEUE_SIZE) % STREAM_QUEUE_SIZE + sizeof(length) + len < STREAM_QUEUE_SIZE;
+    if(fits)
+    {
+        ring_write(length, sizeof(length));
+        ring_write(data, len);
+    }
+    esp_exit_critical();
+    if(fits)    esp_signal_event();
+    // else: dropped - the frame is incomplete, the next frame without XOR repairs it
+}
+
+static size_t stream_queue_get(uint8_t *data)
+{
+    uint8_t length[2];
+    size_t len = 0;
+
+    esp_enter_critical();
+    if(queue_head != queue_tail)
+    {
+        ring_read(length, sizeof(length));
+        len = length[0] | (length[1] << 8);
+        ring_read(data, len);
+    }
+    esp_exit_critical();
+    return len;
+}
+
+static void stream_ws_event(AsyncWebSocket *ws, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+    AwsFrameInfo *info = (AwsFrameInfo *)arg;
+
+    if(type == WS_EVT_CONNECT)  stream_describe(client);
+    if((type != WS_EVT_DATA) || (info->opcode == WS_TEXT) || (info->len > STREAM_PACKET_MAX))   return;
+    if((info->index == 0) && (info->len == len) && info->final)
+    {   // the whole message at once (the usual case)
+        stream_queue_put(data, len);
+        return;
+    }
+    // in parts: collected
+    if(info->index == 0)    ws_client = client->id();
+    else if(client->id() != ws_client)  return;
+    memcpy(ws_message + info->index, data, len);    // (info->len <= STREAM_PACKET_MAX: it fits)
+    if(info->final && (info->index + len >= info->len)) stream_queue_put(ws_message, info->len);
+}
+
+//#############################################################################
+
+void stream_begin(WEBSERVER_CLASS &server)
+{
+    stream_ws.onEvent(stream_ws_event);
+    server.addHandler(&stream_ws);
+    if(!stream_udp.begin(STREAM_PORT))  LOG_WARN("stream: can't listen to UDP port %u", STREAM_PORT);
+}
+
+void stream_loop(void)
+{
+    static uint8_t packet[STREAM_PACKET_MAX];
+    size_t len;
+    int size;
+
+    while((size = stream_udp.parsePacket()) > 0)
+    {
+        len = stream_udp.read(packet, sizeof(packet));
+        if(size <= (int)sizeof(packet)) stream_packet(packet, len);     // (longer ones are not ours)
+    }
+    while((len = stream_queue_get(packet)) > 0) stream_packet(packet, len);
+
+    if(stream_active && time_reached(millis(), stream_last_packet + STREAM_TIMEOUT))
+    {
+        LOG_INFO("stream: no more frames");
+        stream_active = false;
+        stream_invalidate();
+        frame_release();
+    }
+}
+
+uint32_t stream_idle_time(void)
+{
+    return stream_active ? STREAM_POLL_ACTIVE : UINT32_MAX;
+}
@@ -0,0 +1,162 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+sync.cpp - synchronized slideshows, implementation
+
+The difference of the clocks is estimated from the leader's packets: leader clock - own clock when
+receiving it. Every packet is delayed a bit (WiFi, polling), which makes that value smaller than the true
+difference - never larger. So the largest of the last SYNC_OFFSET_SAMPLES values is taken, the one of
+the packet delayed least.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include "esplayer.h"
+#include "settings.h"
+#include "slideshow.h"
+#include "sync.h"
+#include "log.h"
+
+#define SYNC_MAGIC              "TGDS"
+#define SYNC_OFFSET_SAMPLES     8
+#define SYNC_CLOCK_JUMP         1000    // ms; the estimate changes more (e.g. the leader restarted): start anew
+#define SYNC_POLL_INTERVAL      5       // ms between looking for packets: the delay adds to the error of a sample
+
+// "imported" from network.cpp:
+extern bool SoftAccOK;
+
+struct syncPacket
+{
+    char magic[4];
+    uint8_t running;        // 0: the leader's slideshow is stopped
+    uint8_t has_next;       // 1: filename and deadline are valid
+    uint16_t reserved;
+    uint32_t clock;         // the leader's millis() when sending
+    uint32_t deadline;      // when (leader's clock) to show filename
+    char filename[MAX_FILENAME_LEN+1];
+} __attribute__((packed));
+
+static WiFiUDP sync_udp;
+static uint16_t sync_role = 0;      // SETTINGS_SYNC_LEADER / SETTINGS_SYNC_FOLLOWER / 0: neither
+static bool sync_joined = false;    // to the multicast group, in sync_role
+
+// leader: what was sent last (without the clock), and when
+static struct syncPacket sync_sent;
+static uint32_t sync_last_sent;
+
+// follower: leader clock - own clock, per packet
+static int32_t sync_offsets[SYNC_OFFSET_SAMPLES];
+static uint8_t sync_offset_count = 0, sync_offset_pos = 0;
+
+static IPAddress sync_own_address(void)
+{
+    return SoftAccOK ? WiFi.softAPIP() : WiFi.localIP();
+}
+
+static void sync_join(uint16_t role)
+{
+    if(sync_role == SETTINGS_SYNC_FOLLOWER) slideshow_unfollow();   // (else it would wait for the leader forever)
+    sync_udp.stop();
+    sync_role = role;
+    sync_joined = false;
+    sync_offset_count = 0;
+    memset(&sync_sent, 0, sizeof(sync_sent));
+    if(!role)   return;
+    if(!SoftAccOK && (WiFi.status() != WL_CONNECTED))   { sync_role = 0; return; }  // try again when connected
+    sync_joined = esp_udp_begin_multicast(sync_udp, sync_own_address(), SYNC_GROUP, SYNC_PORT);
+    if(sync_joined) LOG_INFO("sync: %s", (role == SETTINGS_SYNC_LEADER) ? "leading" : "following");
+    else            LOG_WARN("sync: can't join the multicast group");
+}
+
+static int32_t sync_offset(void)
+{
+    int32_t offset = sync_offsets[0];
+
+    for(uint8_t i = 1; i < sync_offset_count; ++i)
+        if(sync_offsets[i] > offset)    offset = sync_offsets[i];
+    return offset;
+}
+
+static void sync_offset_add(int32_t offset)
+{
+    if(sync_offset_count)
+    {
+        int32_t difference = offset - sync_offset();
+
+        if((difference > SYNC_CLOCK_JUMP) || (difference < -SYNC_CLOCK_JUMP))   sync_offset_count = 0;
+    }
+    if(!sync_offset_count)  sync_offset_pos = 0;
+    sync_offsets[sync_offset_pos] = offset;
+    sync_offset_pos = (sync_offset_pos + 1) % SYNC_OFFSET_SAMPLES;
+    if(sync_offset_count < SYNC_OFFSET_SAMPLES) ++sync_offset_count;
+}
+
+static void sync_lead(void)
+{
+    struct syncPacket packet;
+    uint32_t deadline = 0;  // (packed: not to be written by address)
+
+    memset(&packet, 0, sizeof(packet));
+    memcpy(packet.magic, SYNC_MAGIC, sizeof(packet.magic));
+    packet.running = slideshow_running();
+    packet.has_next = slideshow_next_slide(packet.filename, &deadline);
+    packet.deadline = deadline;
+    // something new: at once, the same again: every SYNC_INTERVAL (for followers starting later, lost packets)
+    if(!memcmp(&packet, &sync_sent, sizeof(packet)) && !time_reached(millis(), sync_last_sent + SYNC_INTERVAL))
+        return;
+    sync_sent = packet;
+
+    packet.clock = sync_last_sent = millis();
+    if(esp_udp_begin_multicast_packet(sync_udp, sync_own_address(), SYNC_GROUP, SYNC_PORT))
+    {
+        sync_udp.write((const uint8_t *)&packet, sizeof(packet));
+        sync_udp.endPacket();
+    }
+}
+
+static void sync_follow(void)
+{
+    struct syncPacket packet;
+
+    while(sync_udp.parsePacket() > 0)
+    {
+        uint32_t now = millis();
+
+        if((sync_udp.read((uint8_t *)&packet, sizeof(packet)) != sizeof(packet)) ||
+           memcmp(packet.magic, SYNC_MAGIC, sizeof(packet.magic)))
+            continue;
+        packet.filename[MAX_FILENAME_LEN] = '\0';
+        sync_offset_add((int32_t)(packet.clock - now));
+
+        if(!packet.running)
+        {
+            if(slideshow_running()) slideshow_stop();
+        }
+        else if(packet.has_next)
+            slideshow_follow(packet.filename, packet.deadline - sync_offset());
+    }
+}
+
+void sync_loop(void)
+{
+    uint16_t role = SETTINGS_IS_SYNC_LEADER ? SETTINGS_SYNC_LEADER : SETTINGS_IS_SYNC_FOLLOWER ? SETTINGS_SYNC_FOLLOWER : 0;
+
+    if(role != sync_role)   sync_join(role);
+    if(!sync_joined)    return;
+    if(sync_role == SETTINGS_SYNC_LEADER)   sync_lead();
+    else                                    sync_follow();
+}
+
+uint32_t sync_idle_time(void)
+{
+    uint32_t now = millis();
+
+    if(!SETTINGS_IS_SYNC_LEADER && !SETTINGS_IS_SYNC_FOLLOWER)  return UINT32_MAX;  // (a group joined is left by sync_loop())
+    if(!sync_joined)    return 1000;    // (waiting for WiFi)
+    if(sync_role != SETTINGS_SYNC_LEADER)   return SYNC_POLL_INTERVAL;
+    return time_reached(now, sync_last_sent + SYNC_INTERVAL) ? 0 : sync_last_sent + SYNC_INTERVAL - now;
+}
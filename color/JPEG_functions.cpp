@@ -2,7 +2,7 @@
 
 Tobis General Display
 
-JPEG_functions.ino
+JPEG_functions.cpp
 
 This file contains support functions to render the Jpeg images.
 
@@ -14,8 +14,16 @@ ucg variant
 
 ==================================================================================*/
 
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include "esplayer.h"
 #include <Ucglib.h>         // https://github.com/olikraus/ucglib
+extern UCG_DECLARATION;
 #include "gfxlayer.h"
+#include "render.h"
+#include "metrics.h"
+#include "log.h"
 #include <JPEGDecoder.h>    // https://github.com/Bodmer/JPEGDecoder
 
 // extern void drawRGBBitmap(int16_t x, int16_t y, uint16_t *pImg, int16_t win_w, int16_t win_h);
@@ -28,35 +36,32 @@ ucg variant
 //====================================================================================
 void drawJpeg_SPIFFS(const char *filename) {
 
-  Serial.println("===========================");
-  Serial.print("Drawing file: "); Serial.println(filename);
-  Serial.println("===========================");
+  LOG_DEBUG("Drawing file: %s", filename);
 
   // Open the named file (the Jpeg decoder library will close it after rendering image)
-  fs::File jpegFile = SPIFFS.open( filename, "r");    // File handle reference for SPIFFS
+  fs::File jpegFile = ESP_FS.open( filename, "r");    // File handle reference for SPIFFS/LittleFS
   //  File jpegFile = SD.open( filename, FILE_READ);  // or, file handle reference for SD library
  
   if ( !jpegFile ) {
-    Serial.print("ERROR: File \""); Serial.print(filename); Serial.println ("\" not found!");
+    LOG_ERROR("File \"%s\" not found!", filename);
     return;
   }
+  metrics_render_stage(STAGE_OPEN);
 
   // Use one of the three following methods to initialise the decoder:
   //boolean decoded = JpegDec.decodeSdFile(jpegFile); // or pass the SD file handle to the decoder,
-  boolean decoded = JpegDec.decodeFsFile(filename);  // or pass the filename (leading / distinguishes SPIFFS files)
-                                   // Note: the filename can be a String or character array type
+  boolean decoded = JpegDec.decodeFsFile(jpegFile);  // pass the file handle: a filename would always be opened on SPIFFS
   if (decoded) {
-    uint16_t xpos = (gfx_getScreenWidth()-JpegDec.width)/2,
-             ypos = (gfx_getScreenHeight()-JpegDec.height)/2;
              
-    // print information about the image to the serial port
+    // log information about the image
     jpegInfo();
+    metrics_render_stage(STAGE_HEADER);
 
     // render the image into a framebuffer without offset
-    jpegRender(xpos, ypos);
+    jpegRender(0, 0);   // (centered by render_view())
   }
   else {
-    Serial.println("Jpeg file format not supported!");
+    LOG_ERROR("%s: Jpeg file format not supported!", filename);
   }
 }
 
@@ -81,10 +86,11 @@ void jpegRender(int xpos, int ypos) {
   // the current image block size
   uint32_t win_w, win_h;
 
-  // record the current time so we can measure how long it takes to draw an image
-  uint32_t drawTime = millis();
+  // the part of the image shown (see render_set_wall())
+  struct renderView view;
+  if(!render_view(JpegDec.width, JpegDec.height, &view))  view.y1 = view.y0;
 
-  gfx_clearScreen();    // clear previous image
+  gfx_clearBuffer();    // clear previous image
 
   // save the coordinate of the right and bottom edges to assist image cropping
   // to the screen size
@@ -102,31 +108,30 @@ void jpegRender(int xpos, int ypos) {
     int mcu_y = JpegDec.MCUy * mcu_h + ypos;
 
     // check if the image block size needs to be changed for the right edge
-    win_w = (mcu_x + mcu_w <= max_x) ? mcu_w:min_w;
+    win_w = (mcu_x + mcu_w <= (int32_t)max_x) ? mcu_w:min_w;
 
     // check if the image block size needs to be changed for the bottom edge
-    win_h = (mcu_y + mcu_h <= max_y) ? mcu_h:min_h;
+    win_h = (mcu_y + mcu_h <= (int32_t)max_y) ? mcu_h:min_h;
+
+    // below the part shown: done; beside it: decoded (as the following blocks depend on it), but not drawn
+    if (mcu_y - ypos >= view.y1) {
+      JpegDec.abort();
+      break;
+    }
+    if (mcu_y - ypos + (int32_t)win_h <= view.y0 || mcu_x - xpos + (int32_t)win_w <= view.x0 || mcu_x - xpos >= view.x1)
+      continue;
 
     // copy pixels into a contiguous block
     if (win_w != mcu_w)
-      for (int h = 1; h < win_h-1; h++)
-        memcpy(pImg + h * win_w, pImg + (h + 1) * mcu_w, win_w << 1);
-
-    // draw image MCU block only if it will fit on the screen
-    if ( ( mcu_x + win_w) <= gfx_getScreenWidth() && ( mcu_y + win_h) <= gfx_getScreenHeight())
-        drawRGBTile(mcu_x, mcu_y, pImg, win_w, win_h);
-    else if ( ( mcu_y + win_h) >= gfx_getScreenHeight()) 
-        JpegDec.abort();
-  }
-  gfx_flushBuffer();
-
-  // calculate how long it took to draw the image
-  drawTime = millis() - drawTime; // Calculate the time it took
-
-  // print the results to the serial port
-  Serial.print  ("Total render time was    : "); Serial.print(drawTime); Serial.println(" ms");
-  Serial.println("=====================================");
+      for (uint32_t h = 1; h < win_h; h++)
+        memmove(pImg + h * win_w, pImg + h * mcu_w, win_w << 1);
 
+    // draw image MCU block, cropped to the part shown
+    drawRGBTile(mcu_x + view.offset_x, mcu_y + view.offset_y, pImg, win_w, win_h);
+  }
+  metrics_render_stage(STAGE_DECODE);
+  render_flush();
+  metrics_render_stage(STAGE_FLUSH);    // (how long it took to draw the image: see metrics_render_end())
 }
 
 //====================================================================================
@@ -134,18 +139,8 @@ void jpegRender(int xpos, int ypos) {
 //====================================================================================
 void jpegInfo() {
 
-  Serial.println("===============");
-  Serial.println("JPEG image info");
-  Serial.println("===============");
-  Serial.print  ("Width      :"); Serial.println(JpegDec.width);
-  Serial.print  ("Height     :"); Serial.println(JpegDec.height);
-  Serial.print  ("Components :"); Serial.println(JpegDec.comps);
-  Serial.print  ("MCU / row  :"); Serial.println(JpegDec.MCUSPerRow);
-  Serial.print  ("MCU / col  :"); Serial.println(JpegDec.MCUSPerCol);
-  Serial.print  ("Scan type  :"); Serial.println(JpegDec.scanType);
-  Serial.print  ("MCU width  :"); Serial.println(JpegDec.MCUWidth);
-  Serial.print  ("MCU height :"); Serial.println(JpegDec.MCUHeight);
-  Serial.println("===============");
-  Serial.println("");
+  LOG_DEBUG("JPEG image info: width %d, height %d, components %d, MCU / row %d, MCU / col %d, scan type %d, MCU width %d, MCU height %d",
+            (int)JpegDec.width, (int)JpegDec.height, (int)JpegDec.comps, (int)JpegDec.MCUSPerRow, (int)JpegDec.MCUSPerCol,
+            (int)JpegDec.scanType, (int)JpegDec.MCUWidth, (int)JpegDec.MCUHeight);
 }
 //====================================================================================
@@ -31,15 +31,17 @@ changes/extensions:
 #include "bitmap.h"
 #include <JPEGDecoder.h>    // https://github.com/Bodmer/JPEGDecoder
 #include "network.h"
+#include "imageindex.h"
+#include "render.h"
+#include "slideshow.h"
+#include "sync.h"
+#include "stream.h"
+#include "log.h"
 
 // ucg object:
 UCG_CONSTRUCTION;
 #include "gfxlayer.h"       // << this unfortunately requires the ucg/u8g2 object to be declared before
 
-bool slideshow_is_running = false;
-unsigned long slideshow_last_switch = 0;
-int slideshow_current_index = 0;        // next image to display
-
 String temp ="";
 
 void setup(void)
@@ -55,9 +57,12 @@ void setup(void)
     delay(1);
   Serial.println("serial interface initialized at "+String(BAUDS)+" baud");
   gfx_init();
+  if(!gfx_checkScreenSize())
+    Serial.println("CAUTION: DISPLAY_WIDTH/DISPLAY_HEIGHT (config.h) do not match the display!");
 #ifdef SPECIAL_INITIALIZATION
   SPECIAL_INITIALIZATION();
 #endif
+  render_arena_begin();     // before WiFi & co. take their share of the heap
   WiFi.setAutoReconnect (false);
   WiFi.persistent(false);
   WiFi.disconnect();
@@ -86,9 +91,15 @@ void setup(void)
      // Blink
      delay(500);
   }
+  render_set_wall(MySettings.wall_cols, MySettings.wall_rows, MySettings.wall_col, MySettings.wall_row);
   // initialize filesystem
   CInitFSSystem = InitializeFileSystem();
   if (!(CInitFSSystem)) Serial.println(F("file system not initialized !"));
+  else if (!image_index_begin())    // none yet (or an outdated one)
+  {
+    Serial.println(F("building the image index"));
+    scan_images_for_slideshow();
+  }
   if (ConnectSuccess || CreateSoftAPSucc)
     {
       //Serial.print (F("IP Address: "));
@@ -104,258 +115,53 @@ void setup(void)
       // saveSettings();
     }
     InitializeHTTPServer();
+#ifdef POWER_SAVE
+    esp_power_save();
+#endif
 
     doShowWifi(false);
 
     if(SETTINGS_IS_SLIDESHOW_AUTORUN)
     {
-        slideshow_is_running = true;
-        scan_images_for_slideshow();
-        slideshow_last_switch = millis();
+        slideshow_start(NULL);
+        slideshow_suspend();    // the WiFi info stays for a while
     }
 }
 
 boolean InitializeFileSystem() {
   bool initok = false;
-  initok = SPIFFS.begin();
+  initok = esp_fs_begin();
   delay(200);
   if (! initok)
   {
-    Serial.println(F("Format SPIFFS"));
-    SPIFFS.format();
-    initok = SPIFFS.begin();
+    Serial.println(F("Format " ESP_FS_NAME));
+    if (esp_fs_format())  initok = esp_fs_begin();   // (an SD card is not formatted)
   }
   return initok;
 }
 
-uint16_t read16(File f)
-{
-  // BMP data is stored little-endian, same as Arduino.
-  uint16_t result;
-  ((uint8_t *)&result)[0] = f.read(); // LSB
-  ((uint8_t *)&result)[1] = f.read(); // MSB
-  return result;
-}
-
-inline void readrgb(File f, uint8_t *r, uint8_t *g, uint8_t *b)
-{   // read a triple rgb plus a fourth dummy and just return the sum:
-    *b = f.read();
-    *g = f.read();
-    *r = f.read();
-    f.read();   // skip fourth byte to enable reading the next palette entry
-}
-
-uint32_t read32(File f)
-{
-  // BMP data is stored little-endian, same as Arduino.
-  uint32_t result;
-  ((uint8_t *)&result)[0] = f.read(); // LSB
-  ((uint8_t *)&result)[1] = f.read();
-  ((uint8_t *)&result)[2] = f.read();
-  ((uint8_t *)&result)[3] = f.read(); // MSB
-  return result;
-}
-
-BMPHeader ReadBitmapSpecs(String filename)
-{
-  File file;
-  BMPHeader BMPData;
-  file = SPIFFS.open(filename, "r");
-  if (!file)
-  {
-    file.close();
-    return BMPData;
-  }
-  // Parse BMP header
-  if (read16(file) == 0x4D42) // BMP signature
-  {
-    BMPData.fileSize = read32(file);
-    BMPData.creatorBytes = read32(file);
-    BMPData.imageOffset = read32(file); // Start of image data
-    BMPData.headerSize = read32(file);
-    BMPData.width  = read32(file);
-    BMPData.height = read32(file);
-    BMPData.planes = read16(file);
-    BMPData.depth = read16(file); // bits per pixel
-    BMPData.format = read32(file);
-  }
-  file.close();
-  return BMPData;
-}
-
-//#############################################################################
-// draw a tile already loaded to a small memory buffer - called/required by jpegRender()
-// colors are "recieved" as RGB565
-void drawRGBTile(int16_t x, int16_t y, uint16_t *pImg, int16_t width, int16_t height)
-{
-    // Serial.println("drawRGBTile("+String(x)+", "+String(y)+", *pImg, "+String(width)+", "+String(height)+")");
-
-    while(height > 0)
-    {
-        uint16_t cx;
-
-        if(y >= gfx_getScreenHeight())  return; // abort if screen is left
-
-        for(cx=0; cx<width; ++cx)
-        {
-            if(x+cx < gfx_getScreenWidth())
-            {
-                uint8_t red   = ((*pImg >> 8) & 0xf8),
-                        green = ((*pImg >> 3) & 0xfc),
-                        blue  = ((*pImg << 3) & 0xf8);
-                gfx_setPixelColor(red, green, blue);
-                gfx_setPixel(x+cx, y);
-            }
-            ++pImg; // advance in the buffer
-        }
-        // advance to next row
-        ++y; --height;
-    }
-}
-
-//#############################################################################
-
-#define SD_BUFFER_PIXELS 20
-
-void drawBitmap_SPIFFS(const char *filename)
-{
-  File file;
-  uint8_t buffer[3 * SD_BUFFER_PIXELS]; // pixel buffer, size for r,g,b
-  bool valid = false; // valid format to be handled
-  bool flip = true; // bitmap is stored bottom-to-top
-  uint32_t pos = 0;
-
-  file = SPIFFS.open(filename, "r");
-  if (!file)
-  {
-    Serial.print(F("Filesytem Error"));
-    return;
-  }
-  // Parse BMP header
-  if (read16(file) == 0x4D42) // BMP signature
-  {
-    uint32_t fileSize = read32(file);
-    uint32_t creatorBytes = read32(file);
-    uint32_t imageOffset = read32(file); // Start of image data
-    uint32_t headerSize = read32(file);
-    uint32_t width  = read32(file);
-    uint32_t height = read32(file);
-    uint16_t planes = read16(file);
-    uint16_t depth = read16(file); // bits per pixel
-    uint32_t format = read32(file); // compression format; 0=uncompressed
-    if ((planes == 1) && (format == 0) &&   // uncompressed is handled
-        ((depth == 1) || (depth == 24)))    // only 1 or 24bits color depth impplemented
-    {
-      uint8_t red0, green0, blue0, red1, green1, blue1;
-
-      valid = true;
-      Serial.print(F("File name: "));
-      Serial.println(filename);
-      Serial.print(F("File size: "));
-      Serial.println(fileSize);
-      Serial.print(F("Image Offset: "));
-      Serial.println(imageOffset);
-      Serial.print(F("Header size: "));
-      Serial.println(headerSize);
-      Serial.print(F("Bit Depth: "));
-      Serial.println(depth);
-      Serial.print(F("Image size: "));
-      Serial.print(width);
-      Serial.print('*');
-      Serial.println(height);
-
-      if(depth == 1)
-      {   // read the palette
-          file.seek(5*sizeof(uint32_t),SeekCur);    // skip remainder of header, go to start of color table
-          readrgb(file, &red0, &green0, &blue0);
-          readrgb(file, &red1, &green1, &blue1);
-      }
-      uint32_t rowSize = (width * depth / 8 + 3) & ~3;
-      if (height < 0)
-      {
-        height = -height;
-        flip = false;
-      }
-      gfx_clearScreen();
-      uint16_t w = width,  offset_x = (gfx_getScreenWidth()-w)/2;
-      uint16_t h = height, offset_y = (gfx_getScreenHeight()-h)/2;
-      size_t buffidx = sizeof(buffer); // force buffer load
-      for (uint16_t row = 0; row < h; row++) // for each line
-      {
-        pos = imageOffset +
-              (flip ? ((height - 1 - row) * rowSize) :  // Bitmap is stored bottom-to-top order (normal BMP)
-                      (row * rowSize) );                // Bitmap is stored top-to-bottom
-        if (file.position() != pos)
-        { // Need seek?
-          file.seek(pos,SeekSet);   // if mode is SeekSet, position is set to offset bytes from the beginning.
-                                    // if mode is SeekCur, current position is moved by offset bytes.
-                                    // if mode is SeekEnd, position is set to offset bytes from the end of the
-          buffidx = sizeof(buffer); // force buffer reload
-        }
-
-        uint8_t bits;
-        for (uint16_t col = 0; col < w; col++) // for each pixel
-        {
-          // Time to read more pixel data?
-          if (buffidx >= sizeof(buffer))
-          {
-            file.read(buffer, sizeof(buffer));
-            buffidx = 0; // Set index to beginning
-          }
-          switch (depth)
-          {
-            case 1: // one bit per pixel b/w format
-                if (0 == col % 8)
-                    bits = buffer[buffidx++];
-                if(bits & 0x80)
-                    gfx_setPixelColor(red1, green1, blue1);
-                else
-                    gfx_setPixelColor(red0, green0, blue0);
-                bits <<= 1;
-                break;
-            case 24: // standard BMP format
-                blue0  = buffer[buffidx++];
-                green0 = buffer[buffidx++],
-                red0   = buffer[buffidx++];
-                gfx_setPixelColor(red0, green0, blue0);
-                break;
-          }
-          gfx_setPixel(col+offset_x, row+offset_y);
-        } // end pixel
-      } // end line
-      gfx_flushBuffer(); // Show results :)
-    }
-  }
-  file.close();
-  if (! valid)
-  {
-    Serial.println(F("Err: BMP"));
-  }
-}
-
-void drawAnyImageType(const char *filename)
-{
-    char *ext = strrchr(filename, '.');
-    if(!ext)    return; // no extension => we're unable to detect the filetype => we can't call the *corresponding* display method
-    ++ext;  // skip '.' itself
-
-    if(strcasecmp(ext, "bmp") == 0)
-        drawBitmap_SPIFFS(filename);
-    else if(strcasecmp(ext, "jpg") == 0 || strcasecmp(ext, "jpeg") == 0)
-        drawJpeg_SPIFFS(filename);
-}
+// loop() sleeps until there is something to do: the next step of the slideshow or what the HTTP handlers
+// ordered (they wake it up by esp_signal_event()); just the DNS server (captive portal) has to be polled
+#define DNS_POLL_INTERVAL   20      // ms
+#define LOG_DRAIN_INTERVAL  10      // ms, while more is to be sent to the serial port
+#define LOOP_MAX_SLEEP      1000    // ms
 
 void loop(void)
 {
-    if (SoftAccOK)  dnsServer.processNextRequest(); // DNS server
-    server.handleClient();                          // HTTP server
+    uint32_t sleep;
 
-    if(slideshow_is_running &&
-       (slideshow_last_switch + SLIDESHOW_PERIOD < millis()))
-    {
-        if(slideshow_current_index >= slideshow_num_images) slideshow_current_index = 0;
-        drawAnyImageType(slideshow_filenames[slideshow_current_index++]);
-        slideshow_last_switch = millis();
-    }
-    else delay(1);    // some pause to lower pointless CPU load
+    if (SoftAccOK)  dnsServer.processNextRequest(); // DNS server
+    processNetworkActions();                        // HTTP is served asynchronously; just do what the handlers ordered
+
+    if(slideshow_loop())    return;                 // a slide drawn/shown: maybe more is due
+    sync_loop();                                    // synchronized slideshows: tell/hear the next slide
+    stream_loop();                                  // live frames
+
+    sleep = slideshow_idle_time();
+    if(sleep > sync_idle_time())    sleep = sync_idle_time();
+    if(sleep > stream_idle_time())  sleep = stream_idle_time();
+    if(sleep > LOOP_MAX_SLEEP)  sleep = LOOP_MAX_SLEEP;
+    if(log_drain() && (sleep > LOG_DRAIN_INTERVAL)) sleep = LOG_DRAIN_INTERVAL;    // idle: time to send diagnostic messages
+    if(SoftAccOK && (sleep > DNS_POLL_INTERVAL))    sleep = DNS_POLL_INTERVAL;
+    if(sleep)   esp_wait_event(sleep);
 }
@@ -13,37 +13,144 @@ contains several #include's !
 #ifndef ESPLAYER_H
 #define ESPLAYER_H
 
+// the filesystem holding the images (and everything else uploaded), see USE_SD/USE_LITTLEFS in config.h;
+// everything accesses it as ESP_FS (as fs::FS) - the API is the same for all of them
+#if defined(USE_SD)
+#ifdef ESP8266
+#define ESP_FS          SDFS
+#else
+#define ESP_FS          SD
+#endif
+#define ESP_FS_NAME     "SD card"
+#elif defined(USE_LITTLEFS)
+#define ESP_FS          LittleFS
+#define ESP_FS_NAME     "LittleFS"
+#else
+#define ESP_FS          SPIFFS
+#define ESP_FS_NAME     "SPIFFS"
+#endif
+
+#ifdef HOST_BUILD
+// native build of the render code (see host/): the filesystem is a directory of the host, there is no network
+#include <FS.h>
+#include <SPIFFS.h>
+#include <LittleFS.h>
+#include <SD.h>
+
+inline void esp_enter_critical(void) {}
+inline void esp_exit_critical(void)  {}
+
+// heap figures: not available (0)
+inline uint32_t esp_heap_free(void)             { return 0; }
+inline size_t esp_psram_size(void)              { return 0; }
+inline void *esp_psram_malloc(size_t size)      { return NULL; }
+inline uint32_t esp_heap_min_free(void)         { return 0; }
+inline uint32_t esp_heap_largest_block(void)    { return 0; }
+
+inline bool esp_fs_begin(void)  { return ESP_FS.begin(); }
+inline bool esp_fs_format(void) { return false; }   // never wipe a directory of the host
+inline size_t esp_get_fs_usedBytes(void)  { return ESP_FS.usedBytes(); }
+inline size_t esp_get_fs_totalBytes(void) { return ESP_FS.totalBytes(); }
+
+#define ESP_CLASS_DIR   File
+inline fs::File esp_openDir(const char* path) { return ESP_FS.open(path); }
+inline fs::File esp_openNextFile(fs::File dir) { return dir.openNextFile(); }
+inline String esp_filePath(fs::File &file) { return file.path(); }
+
+#else
+
 #ifdef ESP8266
 #include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
 #include <WiFiClient.h>
-#include <ESP8266WebServer.h>
 #include <ESP8266mDNS.h>
 #define FS_NO_GLOBALS       // required ba JPEGDecoder
 #include <FS.h>
+#if defined(USE_SD)
+#include <SDFS.h>
+#elif defined(USE_LITTLEFS)
+#include <LittleFS.h>
+#endif
+#include <ESPAsyncTCP.h>        // https://github.com/me-no-dev/ESPAsyncTCP
+#include <ESPAsyncWebServer.h>  // https://github.com/me-no-dev/ESPAsyncWebServer
+
+#define WEBSERVER_CLASS     AsyncWebServer
 
-#define WEBSERVER_CLASS     ESP8266WebServer
+// data shared between the (asynchronous) HTTP handlers and loop():
+// the handlers run in the system context, never interrupting loop() - nothing to lock
+inline void esp_enter_critical(void) {}
+inline void esp_exit_critical(void)  {}
 
 inline void esp_guru_meditation_error_remediation(void) {}  // that is ESP32 specific
 inline void esp_wifi_set_hostname(const char *name) { WiFi.hostname(name); }
-inline size_t esp_get_fs_usedBytes(void)  { struct FSInfo fsi; return SPIFFS.info(fsi) ? fsi.usedBytes  : -1; }
-inline size_t esp_get_fs_totalBytes(void) { struct FSInfo fsi; return SPIFFS.info(fsi) ? fsi.totalBytes : -1; }
+
+// loop() sleeps by esp_wait_event() until the timeout or until a handler calls esp_signal_event();
+// during delay() the system (WiFi, the handlers) runs - and in light sleep mode the modem sleeps in between
+inline volatile bool *esp_event_flag(void) { static volatile bool flag = false; return &flag; }
+inline void esp_signal_event(void) { *esp_event_flag() = true; }
+inline void esp_wait_event(uint32_t timeout_ms)
+{
+    uint32_t start = millis(), passed;
+
+    while(!*esp_event_flag() && ((passed = millis() - start) < timeout_ms))
+        delay((timeout_ms - passed < 10) ? timeout_ms - passed : 10);   // a signal is noticed within 10ms
+    *esp_event_flag() = false;
+}
+inline void esp_power_save(void) { WiFi.setSleepMode(WIFI_LIGHT_SLEEP); }   // (station mode only)
+
+// UDP multicast: receiving and sending by the interface with the address own
+inline bool esp_udp_begin_multicast(WiFiUDP &udp, IPAddress own, IPAddress group, uint16_t port) { return udp.beginMulticast(own, group, port); }
+inline bool esp_udp_begin_multicast_packet(WiFiUDP &udp, IPAddress own, IPAddress group, uint16_t port) { return udp.beginPacketMulticast(group, port, own); }
+
+// heap figures, in bytes; the minimum ever is not tracked by the core (0: unknown)
+inline uint32_t esp_heap_free(void)             { return ESP.getFreeHeap(); }
+inline uint32_t esp_heap_min_free(void)         { return 0; }
+inline uint32_t esp_heap_largest_block(void)    { return ESP.getMaxFreeBlockSize(); }
+// there is no PSRAM
+inline size_t esp_psram_size(void)              { return 0; }
+inline void *esp_psram_malloc(size_t size)      { return NULL; }
+#ifdef USE_SD
+inline bool esp_fs_begin(void)  { SDFS.setConfig(SDFSConfig(SD_CS_PIN)); return SDFS.begin(); }
+inline bool esp_fs_format(void) { return false; }   // a card is formatted elsewhere
+#else
+inline bool esp_fs_begin(void)  { return ESP_FS.begin(); }
+inline bool esp_fs_format(void) { return ESP_FS.format(); }
+#endif
+inline size_t esp_get_fs_usedBytes(void)  { struct FSInfo fsi; return ESP_FS.info(fsi) ? fsi.usedBytes  : -1; }
+inline size_t esp_get_fs_totalBytes(void) { struct FSInfo fsi; return ESP_FS.info(fsi) ? fsi.totalBytes : -1; }
 
 // directory scanning works quite different for ESP8266 and ESP32...
 #define ESP_CLASS_DIR   Dir
-inline Dir esp_openDir(const char* path) { return SPIFFS.openDir(path); }
+inline Dir esp_openDir(const char* path) { return ESP_FS.openDir(path); }
 inline File esp_openNextFile(Dir dir) { do dir.next(); while(dir.isDirectory()); return dir.openFile("r"); }
+// the full path of a file, with leading '/' (as used by open() etc.; LittleFS' name() is just the name without the directory)
+inline String esp_filePath(File &file) { String path = file.fullName(); return path.startsWith("/") ? path : "/" + path; }
 
 #endif
 
 #ifdef ESP32
 #include <WiFi.h>
+#include <WiFiUdp.h>
 #include <WiFiClient.h>
-#include <WebServer.h>
 #include <ESPmDNS.h>
 #define FS_NO_GLOBALS       // required ba JPEGDecoder
+#if defined(USE_SD)
+#include <SD.h>
+#elif defined(USE_LITTLEFS)
+#include <LittleFS.h>
+#else
 #include <SPIFFS.h>
+#endif
+#include <AsyncTCP.h>           // https://github.com/me-no-dev/AsyncTCP
+#include <ESPAsyncWebServer.h>  // https://github.com/me-no-dev/ESPAsyncWebServer
+
+#define WEBSERVER_CLASS     AsyncWebServer
 
-#define WEBSERVER_CLASS     WebServer
+// data shared between the (asynchronous) HTTP handlers and loop():
+// the handlers run in a task of their own (maybe on the other core) - short critical sections required
+inline portMUX_TYPE *esp_critical_mux(void) { static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED; return &mux; }
+inline void esp_enter_critical(void) { portENTER_CRITICAL(esp_critical_mux()); }
+inline void esp_exit_critical(void)  { portEXIT_CRITICAL(esp_critical_mux()); }
 
 #define GPIO_OUT_W1TS_REG (DR_REG_GPIO_BASE + 0x0008)
 #define GPIO_OUT_W1TC_REG (DR_REG_GPIO_BASE + 0x000c)
@@ -56,14 +163,49 @@ inline void esp_guru_meditation_error_remediation(void)
 }
 
 inline void esp_wifi_set_hostname(const char *name) { WiFi.setHostname(name); }
-inline size_t esp_get_fs_usedBytes(void)  { return SPIFFS.usedBytes(); }
-inline size_t esp_get_fs_totalBytes(void) { return SPIFFS.totalBytes(); }
+
+// loop() sleeps by esp_wait_event() - the CPU idles, waiting for interrupts - until the timeout or until
+// a handler calls esp_signal_event()
+inline TaskHandle_t *esp_loop_task(void) { static TaskHandle_t task = NULL; return &task; }
+inline void esp_signal_event(void) { if(*esp_loop_task()) xTaskNotifyGive(*esp_loop_task()); }
+inline void esp_wait_event(uint32_t timeout_ms)
+{
+    *esp_loop_task() = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms));
+}
+// the modem wakes up for the beacons only (station mode only; in AP mode there is no modem sleep), slower CPU clock
+inline void esp_power_save(void) { WiFi.setSleep(WIFI_PS_MAX_MODEM); setCpuFrequencyMhz(80); }
+
+// UDP multicast: receiving and sending (the interface is chosen by the routing: own is not needed)
+inline bool esp_udp_begin_multicast(WiFiUDP &udp, IPAddress own, IPAddress group, uint16_t port) { return udp.beginMulticast(group, port); }
+inline bool esp_udp_begin_multicast_packet(WiFiUDP &udp, IPAddress own, IPAddress group, uint16_t port) { return udp.beginPacket(group, port); }
+
+// heap figures, in bytes
+inline uint32_t esp_heap_free(void)             { return ESP.getFreeHeap(); }
+inline uint32_t esp_heap_min_free(void)         { return ESP.getMinFreeHeap(); }
+inline uint32_t esp_heap_largest_block(void)    { return ESP.getMaxAllocHeap(); }
+// PSRAM (external RAM, some boards): its size (0: there is none), allocating from it
+inline size_t esp_psram_size(void)              { return psramFound() ? ESP.getPsramSize() : 0; }
+inline void *esp_psram_malloc(size_t size)      { return ps_malloc(size); }
+#ifdef USE_SD
+inline bool esp_fs_begin(void)  { return SD.begin(SD_CS_PIN); }
+inline bool esp_fs_format(void) { return false; }   // a card is formatted elsewhere
+#else
+inline bool esp_fs_begin(void)  { return ESP_FS.begin(); }
+inline bool esp_fs_format(void) { return ESP_FS.format(); }
+#endif
+inline size_t esp_get_fs_usedBytes(void)  { return ESP_FS.usedBytes(); }
+inline size_t esp_get_fs_totalBytes(void) { return ESP_FS.totalBytes(); }
 
 // directory scanning works quite different for ESP8266 and ESP32...
 #define ESP_CLASS_DIR   File
-inline fs::File esp_openDir(const char* path) { return SPIFFS.open(path); }
+inline fs::File esp_openDir(const char* path) { return ESP_FS.open(path); }
 inline fs::File esp_openNextFile(fs::File dir) { return dir.openNextFile(); }
+// the full path of a file, with leading '/' (as used by open() etc.; LittleFS' name() is just the name without the directory)
+inline String esp_filePath(fs::File &file) { String path = file.path(); return path.startsWith("/") ? path : "/" + path; }
 
 #endif
 
+#endif HOST_BUILD
+
 #endif ESPLAYER_H
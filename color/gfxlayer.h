@@ -14,20 +14,82 @@ ucg variant
 #ifndef GFXLAYER_H
 #define GFXLAYER_H
 
-inline void gfx_flushBuffer(void)                               { }     // write the whole buffer to the display - only needed if the gfx system uses a framebuffer instead of writing everything to the display immediately
-inline void gfx_clearScreen(void)                               { ucg.clearScreen(); }
+#ifdef DISPLAY_WIDTH    // known at compile time (config.h): constants in the drawing loops
+inline uint16_t gfx_getScreenWidth(void)                        { return DISPLAY_WIDTH; }
+inline uint16_t gfx_getScreenHeight(void)                       { return DISPLAY_HEIGHT; }
+#else
 inline uint16_t gfx_getScreenWidth(void)                        { return ucg.getWidth(); }
 inline uint16_t gfx_getScreenHeight(void)                       { return ucg.getHeight(); }
+#endif
+// false: DISPLAY_WIDTH/DISPLAY_HEIGHT do not match the display configured
+inline bool gfx_checkScreenSize(void)                           { return (gfx_getScreenWidth() == ucg.getWidth()) && (gfx_getScreenHeight() == ucg.getHeight()); }
+
+#ifdef SCREEN_BUFFER    // an RGB565 buffer in memory (screenbuffer.cpp); without memory for it, drawn directly
+struct screenSpan { uint16_t x0, x1; };     // the columns of a row changed since the last flush: x0 <= x < x1
+extern uint16_t *screen_buffer;             // row by row
+extern struct screenSpan *screen_dirty;     // per row
+extern uint8_t *screen_drawn;               // a bit per pixel: set since gfx_clearBuffer() (NULL: not cleared)
+extern uint16_t screen_color;
+bool screen_begin(void);
+void screen_settle(void);                   // after gfx_clearBuffer(): the pixels not drawn since become black
+void screen_flush(void);                    // send the pixels changed, a run of one color at once
+void screen_clear(bool display);            // false: the buffer only
+void screen_invalidate(bool text);          // the display may differ from the buffer - text: where text was drawn
+
+inline void screen_setPixel(uint16_t x, uint16_t y)
+{
+    uint32_t i = x + y*gfx_getScreenWidth();
+
+    if(!screen_buffer)  { ucg.drawPixel(x, y); return; }
+    if((x >= gfx_getScreenWidth()) || (y >= gfx_getScreenHeight())) return;
+    if(screen_drawn)    screen_drawn[i/8] |= 1 << (i & 7);
+    if(screen_buffer[i] == screen_color)    return;     // (unchanged: not to be sent again)
+    screen_buffer[i] = screen_color;
+    if(x < screen_dirty[y].x0)  screen_dirty[y].x0 = x;
+    if(x >= screen_dirty[y].x1) screen_dirty[y].x1 = x+1;
+}
+#endif
+
+#ifdef SCREEN_BUFFER
+inline void gfx_flushBuffer(void)                               { screen_flush(); }
+inline void gfx_clearScreen(void)                               { screen_clear(true); }
+inline void gfx_clearBuffer(void)                               { screen_clear(false); }
+inline void gfx_setPixel(uint16_t x, uint16_t y)                { screen_setPixel(x, y); }
+inline void gfx_setPixelColor(uint8_t r, uint8_t g, uint8_t b)  { screen_color = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3); if(!screen_buffer) ucg.setColor(r, g, b); }
+inline void gfx_setTextColor(uint8_t r, uint8_t g, uint8_t b)   { ucg.setColor(r, g, b); }
+inline void gfx_drawString(uint16_t x, uint16_t y, const char *str)   { ucg.drawString(x,y, 0, str); screen_invalidate(true); }    // (directly to the display)
+// direct access to the buffer (NULL: there is none), RGB565 row by row
+inline uint8_t *gfx_getBuffer(void)                             { screen_settle(); return (uint8_t *)screen_buffer; }
+inline size_t gfx_getBufferSize(void)                           { return screen_buffer ? 2 * gfx_getScreenWidth() * gfx_getScreenHeight() : 0; }
+// the buffer was written directly (by gfx_getBuffer()): the next flush sends all of it
+inline void gfx_markBuffer(void)                                { screen_invalidate(false); }
+// like gfx_flushBuffer(), but just the area given
+inline void gfx_flushArea(uint16_t x, uint16_t y, uint16_t w, uint16_t h)   { screen_flush(); }  // (the changes are known anyway)
+#else
+inline void gfx_flushBuffer(void)                               { }     // write the whole buffer to the display - only needed if the gfx system uses a framebuffer instead of writing everything to the display immediately
+inline void gfx_clearScreen(void)                               { ucg.clearScreen(); }
+inline void gfx_clearBuffer(void)                               { ucg.clearScreen(); }  // like gfx_clearScreen(), but the display shows it by the next gfx_flushBuffer() only
 inline void gfx_setPixel(uint16_t x, uint16_t y)                { ucg.drawPixel(x, y); }
 inline void gfx_setPixelColor(uint8_t r, uint8_t g, uint8_t b)  { ucg.setColor(r, g, b); }
 inline void gfx_setTextColor(uint8_t r, uint8_t g, uint8_t b)   { ucg.setColor(r, g, b); }
 inline void gfx_drawString(uint16_t x, uint16_t y, const char *str)   { ucg.drawString(x,y, 0, str); }
+// direct access to the buffer (NULL: there is none)
+inline uint8_t *gfx_getBuffer(void)                             { return NULL; }
+inline size_t gfx_getBufferSize(void)                           { return 0; }
+// the buffer was written directly (by gfx_getBuffer()): the next flush sends all of it
+inline void gfx_markBuffer(void)                                { }
+// like gfx_flushBuffer(), but just the area given
+inline void gfx_flushArea(uint16_t x, uint16_t y, uint16_t w, uint16_t h)   { }
+#endif
 
 inline void gfx_init(void)  // calls gfx_clearScreen() and gfx_flushBuffer(); therefore defined afterwards
 {
     ucg.begin(UCG_FONT_MODE_TRANSPARENT);
     ucg.setFont(ucg_font_ncenR10_tr);
     ucg.setFontMode(UCG_FONT_MODE_TRANSPARENT);
+#ifdef SCREEN_BUFFER
+    screen_begin();     // (early: before the heap is fragmented)
+#endif
     gfx_clearScreen();
     gfx_flushBuffer();
 }
@@ -0,0 +1,179 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+gfxsniff.cpp - incremental check of image file headers, implementation
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include "esplayer.h"
+#include "gfxsniff.h"
+
+// states of the JPEG marker walk:
+#define JS_SOI          0   // expecting the SOI marker (0xff 0xd8)
+#define JS_MARKER       1   // expecting 0xff introducing a marker
+#define JS_CODE         2   // expecting the marker code (maybe after 0xff fill bytes)
+#define JS_LEN_HI       3   // segment length, MSB
+#define JS_LEN_LO       4   // segment length, LSB
+#define JS_SOF          5   // reading the SOF segment: precision, height, width
+#define JS_SKIP         6   // skipping the rest of some segment
+
+GFI_TYPE gfxTypeFromFilename(const char *filename)
+{
+    const char *ext = strrchr(filename, '.');
+    if(!ext)    return GFI_TYPE_INVALID;    // no extension found => type undeterminable
+    ++ext;  // skip '.' itself
+
+    if(strcasecmp(ext, "bmp") == 0)                                     return GFI_TYPE_BMP;
+    if((strcasecmp(ext, "jpg") == 0) || (strcasecmp(ext, "jpeg") == 0))  return GFI_TYPE_JPG;
+    return GFI_TYPE_INVALID;
+}
+
+void sniff_begin(struct gfxSniffer *sniffer, GFI_TYPE type)
+{
+    memset(sniffer, 0, sizeof(*sniffer));
+    sniffer->info.type = type;
+    sniffer->result = (type == GFI_TYPE_BMP || type == GFI_TYPE_JPG) ? SNIFF_MORE : SNIFF_INVALID;
+    sniffer->jstate = JS_SOI;
+}
+
+// BMP data is stored little-endian
+static uint32_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+static SNIFF_RESULT sniff_bmp(struct gfxSniffer *sniffer, const uint8_t *data, size_t len)
+{
+    const uint8_t *h = sniffer->header;
+
+    // collect the fixed size part of the header
+    while(len && sniffer->pos < sizeof(sniffer->header))
+    {
+        sniffer->header[sniffer->pos++] = *data++;
+        --len;
+    }
+    if(sniffer->pos < sizeof(sniffer->header))  return SNIFF_MORE;
+
+    // same layout as read by ReadBitmapSpecs()
+    if(le16(h) != 0x4D42)                       return SNIFF_INVALID;   // BMP signature
+    sniffer->info.width  = le32(h+18);
+    sniffer->info.height = le32(h+22);
+    sniffer->info.depth  = le16(h+28);
+    if((le16(h+26) != 1) || (le32(h+30) != 0))  return SNIFF_INVALID;   // planes, compression
+    if((sniffer->info.depth != 1) && (sniffer->info.depth != 24))   return SNIFF_INVALID;
+    return SNIFF_OK;
+}
+
+static SNIFF_RESULT sniff_jpeg(struct gfxSniffer *sniffer, const uint8_t *data, size_t len)
+{
+    for( ; len; ++data, --len, ++sniffer->pos)
+    {
+        uint8_t b = *data;
+
+        switch(sniffer->jstate)
+        {
+            case JS_SOI:
+                if(b != ((sniffer->pos == 0) ? 0xff : 0xd8))    return SNIFF_INVALID;
+                if(sniffer->pos == 1)   sniffer->jstate = JS_MARKER;
+                break;
+            case JS_MARKER:
+                if(b != 0xff)   return SNIFF_INVALID;   // not at a marker => corrupt
+                sniffer->jstate = JS_CODE;
+                break;
+            case JS_CODE:
+                if(b == 0xff)   break;                  // fill byte
+                if(b == 0x01 || (b >= 0xd0 && b <= 0xd7))   // markers without payload
+                {
+                    sniffer->jstate = JS_MARKER;
+                    break;
+                }
+                if(b == 0xd9 || b == 0xda)  return SNIFF_INVALID;   // EOI/SOS before any SOF => no image size
+                sniffer->marker = b;
+                sniffer->jstate = JS_LEN_HI;
+                break;
+            case JS_LEN_HI:
+                sniffer->remaining = b << 8;
+                sniffer->jstate = JS_LEN_LO;
+                break;
+            case JS_LEN_LO:
+                sniffer->remaining |= b;
+                if(sniffer->remaining < 2)  return SNIFF_INVALID;
+                sniffer->remaining -= 2;                // the length includes itself
+                if(sniffer->marker == 0xc0 || sniffer->marker == 0xc1)  // SOF0/SOF1: baseline/extended sequential, huffman
+                {
+                    if(sniffer->remaining < 5)  return SNIFF_INVALID;
+                    sniffer->header[0] = 0;             // number of SOF bytes collected
+                    sniffer->jstate = JS_SOF;
+                }
+                else if((sniffer->marker & 0xf0) == 0xc0 && sniffer->marker != 0xc4 && sniffer->marker != 0xc8 && sniffer->marker != 0xcc)
+                    return SNIFF_INVALID;               // any other SOF: progressive, lossless, arithmetic - unsupported
+                else
+                    sniffer->jstate = sniffer->remaining ? JS_SKIP : JS_MARKER;
+                break;
+            case JS_SOF:
+                sniffer->header[1 + sniffer->header[0]++] = b;
+                if(sniffer->header[0] == 5)
+                {   // precision, height (2 bytes), width (2 bytes), all big-endian
+                    sniffer->info.height = (sniffer->header[2] << 8) | sniffer->header[3];
+                    sniffer->info.width  = (sniffer->header[4] << 8) | sniffer->header[5];
+                    sniffer->info.depth  = 24;
+                    ++sniffer->pos;
+                    return SNIFF_OK;
+                }
+                break;
+            case JS_SKIP:
+                {   // skip as much of the segment as available at once
+                    size_t n = (len < sniffer->remaining) ? len : sniffer->remaining;
+                    sniffer->remaining -= n;
+                    sniffer->pos  += n-1;
+                    data += n-1;
+                    len  -= n-1;
+                    if(!sniffer->remaining) sniffer->jstate = JS_MARKER;
+                }
+                break;
+        }
+    }
+    return SNIFF_MORE;
+}
+
+SNIFF_RESULT sniff_feed(struct gfxSniffer *sniffer, const uint8_t *data, size_t len)
+{
+    if(sniffer->result != SNIFF_MORE)   return sniffer->result;
+    switch(sniffer->info.type)
+    {
+        case GFI_TYPE_BMP:  sniffer->result = sniff_bmp (sniffer, data, len);  break;
+        case GFI_TYPE_JPG:  sniffer->result = sniff_jpeg(sniffer, data, len);  break;
+        default:            sniffer->result = SNIFF_INVALID;
+    }
+    return sniffer->result;
+}
+
+bool sniffFile(const char *filename, struct gfxFileInfo *info)
+{
+    return sniffFileAs(filename, gfxTypeFromFilename(filename), info);
+}
+
+bool sniffFileAs(const char *filename, GFI_TYPE type, struct gfxFileInfo *info)
+{
+    struct gfxSniffer sniffer;
+    uint8_t buffer[64];
+    File file;
+
+    sniff_begin(&sniffer, type);
+    if(sniffer.result != SNIFF_MORE)    return false;
+    file = ESP_FS.open(filename, "r");
+    if(!file)   return false;
+    while(sniffer.result == SNIFF_MORE)
+    {
+        size_t n = file.read(buffer, sizeof(buffer));
+        if(!n)  break;  // EOF before the header was complete
+        sniff_feed(&sniffer, buffer, n);
+    }
+    file.close();
+    if(sniffer.result != SNIFF_OK)  return false;
+    *info = sniffer.info;
+    return true;
+}
@@ -0,0 +1,154 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+imagecache.cpp - the display buffers of images drawn recently, implementation
+
+The table of entries and the buffers are allocated when needed and then kept: the cache does not free
+and allocate again per image (which would fragment the heap), it just reuses what it has.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include <stdlib.h>
+#include "esplayer.h"
+#include <Ucglib.h>         // https://github.com/olikraus/ucglib
+extern UCG_DECLARATION;
+#include "gfxlayer.h"
+#include "imagecache.h"
+#include "log.h"
+
+struct imageCacheEntry
+{
+    uint32_t hash;              // of the filename; 0: unused
+    uint32_t size, stamp;       // of the file when it was drawn
+    uint32_t used;              // when it was shown last (cache_clock)
+    uint8_t *buffer;            // the display buffer; allocated once, kept when the entry is replaced
+    char filename[MAX_FILENAME_LEN+1];
+};
+
+static struct imageCacheEntry *cache = NULL;
+static uint16_t cache_slots = 0;
+static size_t cache_buffer_size;
+static bool cache_unusable = false;         // no buffer or no memory: don't try again
+static uint32_t cache_clock = 0;
+static volatile bool cache_outdated = false;
+
+static void *cache_alloc(size_t size)       // from PSRAM, if there is any
+{
+    void *p = esp_psram_size() ? esp_psram_malloc(size) : NULL;
+
+    return p ? p : malloc(size);
+}
+
+static bool cache_begin(void)
+{
+    uint32_t budget = esp_psram_size() ? IMAGE_CACHE_PSRAM_SIZE : IMAGE_CACHE_SIZE;
+
+    if(cache)   return true;
+    if(cache_unusable)  return false;
+    cache_unusable = true;
+    if(!gfx_getBuffer())    return false;
+#ifdef GRAYSCALE
+    return false;   // (the buffer holds one of the bit planes only)
+#endif
+    cache_buffer_size = gfx_getBufferSize();
+    cache_slots = (budget / cache_buffer_size < UINT16_MAX) ? budget / cache_buffer_size : UINT16_MAX;
+    if(!cache_slots)    return false;
+    cache = (struct imageCacheEntry *)cache_alloc(cache_slots * sizeof(*cache));
+    if(!cache)
+    {
+        LOG_WARN("image cache: no memory for %u entries", cache_slots);
+        return false;
+    }
+    memset(cache, 0, cache_slots * sizeof(*cache));
+    cache_unusable = false;
+    LOG_INFO("image cache: %u images of %u bytes", cache_slots, (unsigned)cache_buffer_size);
+    return true;
+}
+
+static struct imageCacheEntry *cache_find(const struct imageCacheKey *key)
+{
+    if(cache_outdated)
+    {
+        cache_outdated = false;
+        for(uint16_t i = 0; i < cache_slots; ++i)   cache[i].hash = 0;
+    }
+    for(uint16_t i = 0; i < cache_slots; ++i)
+        if((cache[i].hash == key->hash) && !strcmp(cache[i].filename, key->filename))
+            return &cache[i];
+    return NULL;
+}
+
+static uint32_t cache_hash(const char *filename)    // FNV-1a; never 0 (that marks unused entries)
+{
+    uint32_t hash = 2166136261u;
+
+    while(*filename)    hash = (hash ^ (uint8_t)*filename++) * 16777619u;
+    return hash ? hash : 1;
+}
+
+bool image_cache_restore(const char *filename, struct imageCacheKey *key)
+{
+    struct imageCacheEntry *entry;
+    File file;
+
+    key->valid = false;
+    if(!cache_begin())  return false;
+    strncpy(key->filename, filename, MAX_FILENAME_LEN);
+    key->filename[MAX_FILENAME_LEN] = '\0';
+    key->hash = cache_hash(key->filename);
+    file = ESP_FS.open(filename, "r");
+    if(!file)   return false;
+    key->size = file.size();
+    key->stamp = file.getLastWrite();
+    key->valid = true;
+    file.close();
+
+    entry = cache_find(key);
+    if(!entry)  return false;
+    if((entry->size != key->size) || (entry->stamp != key->stamp))
+    {   // the file was replaced
+        entry->hash = 0;
+        return false;
+    }
+    memcpy(gfx_getBuffer(), entry->buffer, cache_buffer_size);
+    gfx_markBuffer();
+    entry->used = ++cache_clock;
+    LOG_DEBUG("image cache: %s", filename);
+    return true;
+}
+
+void image_cache_store(const struct imageCacheKey *key)
+{
+    struct imageCacheEntry *entry, *lru = NULL;
+
+    if(!key->valid || !cache_begin())   return;
+    entry = cache_find(key);
+    for(uint16_t i = 0; !entry && (i < cache_slots); ++i)   // a free one - or the one shown least recently
+    {
+        if(!cache[i].hash)  entry = &cache[i];
+        else if(cache[i].buffer && (!lru || (int32_t)(cache[i].used - lru->used) < 0))  lru = &cache[i];
+    }
+    if(!entry)  entry = lru;
+    if(entry && !entry->buffer)
+    {
+        entry->buffer = (uint8_t *)cache_alloc(cache_buffer_size);
+        if(!entry->buffer)  entry = lru;    // (no more memory: replace one)
+    }
+    if(!entry)  return;
+    memcpy(entry->buffer, gfx_getBuffer(), cache_buffer_size);
+    strcpy(entry->filename, key->filename);
+    entry->hash = key->hash;
+    entry->size = key->size;
+    entry->stamp = key->stamp;
+    entry->used = ++cache_clock;
+}
+
+void image_cache_changed(void)
+{
+    cache_outdated = true;
+}
@@ -0,0 +1,185 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+imageindex.cpp - persistent index of the displayable images, implementation
+
+the file consists of a header and image_index_count() records; it may be longer (after removals),
+the rest is garbage. all changes are made by loop() (the HTTP handlers queue theirs, see processNetworkActions()).
+records are written before the header counts them, so neither an HTTP handler listing the images meanwhile
+nor the index left by a reset within a change counts an unwritten one.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include "esplayer.h"
+#include "imageindex.h"
+
+#define IMAGE_INDEX_MAGIC   "TGDI"
+
+struct imageIndexHeader
+{
+    char magic[4];
+    uint16_t record_size;   // detects a changed record layout (e.g. by another MAX_FILENAME_LEN)
+    uint16_t reserved;
+    uint32_t count;
+};
+
+static uint32_t index_count = 0;
+
+// position of record pos within the file
+static inline uint32_t record_offset(uint32_t pos)
+{
+    return sizeof(struct imageIndexHeader) + pos * sizeof(struct imageIndexRecord);
+}
+
+static bool write_header(File &file, uint32_t count)
+{
+    struct imageIndexHeader header;
+
+    memcpy(header.magic, IMAGE_INDEX_MAGIC, sizeof(header.magic));
+    header.record_size = sizeof(struct imageIndexRecord);
+    header.reserved = 0;
+    header.count = count;
+    if(!file.seek(0, SeekSet))  return false;
+    if(file.write((const uint8_t *)&header, sizeof(header)) != sizeof(header))  return false;
+    index_count = count;
+    return true;
+}
+
+static bool write_record(File &file, uint32_t pos, const struct imageIndexRecord *record)
+{
+    if(!file.seek(record_offset(pos), SeekSet)) return false;
+    return file.write((const uint8_t *)record, sizeof(*record)) == sizeof(*record);
+}
+
+// position of filename in the index; -1: not found
+static int32_t find_record(File &file, const char *filename, struct imageIndexRecord *record)
+{
+    uint32_t pos;
+
+    if(!file.seek(record_offset(0), SeekSet))   return -1;
+    for(pos = 0; pos < index_count; pos++)
+    {
+        if(file.read((uint8_t *)record, sizeof(*record)) != sizeof(*record))  return -1;
+        if(strncmp(record->filename, filename, MAX_FILENAME_LEN+1) == 0)    return pos;
+    }
+    return -1;
+}
+
+static void fill_record(struct imageIndexRecord *record, const char *filename, const struct gfxFileInfo *info, uint32_t size)
+{
+    memset(record, 0, sizeof(*record));
+    strncpy(record->filename, filename, MAX_FILENAME_LEN);
+    record->type   = info->type;
+    record->depth  = info->depth;
+    record->width  = info->width;
+    record->height = info->height;
+    record->size   = size;
+}
+
+bool image_index_begin(void)
+{
+    struct imageIndexHeader header;
+    File file = ESP_FS.open(IMAGE_INDEX_FILENAME, "r");
+    bool valid = false;
+
+    index_count = 0;
+    if(!file)   return false;
+    if((file.read((uint8_t *)&header, sizeof(header)) == sizeof(header)) &&
+       (memcmp(header.magic, IMAGE_INDEX_MAGIC, sizeof(header.magic)) == 0) &&
+       (header.record_size == sizeof(struct imageIndexRecord)) &&
+       (file.size() >= record_offset(header.count)))
+    {
+        index_count = header.count;
+        valid = true;
+    }
+    file.close();
+    return valid;
+}
+
+bool image_index_clear(void)
+{
+    File file = ESP_FS.open(IMAGE_INDEX_FILENAME, "w");
+    bool ok;
+
+    if(!file)   return false;
+    ok = write_header(file, 0);
+    file.close();
+    return ok;
+}
+
+uint32_t image_index_count(void)
+{
+    return index_count;
+}
+
+bool image_index_get(uint32_t pos, struct imageIndexRecord *record)
+{
+    File file;
+    bool ok;
+
+    if(pos >= index_count)  return false;
+    file = ESP_FS.open(IMAGE_INDEX_FILENAME, "r");
+    if(!file)   return false;
+    ok = file.seek(record_offset(pos), SeekSet) &&
+         (file.read((uint8_t *)record, sizeof(*record)) == sizeof(*record));
+    file.close();
+    record->filename[MAX_FILENAME_LEN] = '\0';
+    return ok;
+}
+
+bool image_index_append(const char *filename, const struct gfxFileInfo *info, uint32_t size)
+{
+    struct imageIndexRecord record;
+    File file = ESP_FS.open(IMAGE_INDEX_FILENAME, "r+");
+    bool ok;
+
+    if(!file)   return false;
+    fill_record(&record, filename, info, size);
+    ok = write_record(file, index_count, &record) && write_header(file, index_count+1);
+    file.close();
+    return ok;
+}
+
+bool image_index_add(const char *filename, const struct gfxFileInfo *info, uint32_t size)
+{
+    struct imageIndexRecord record;
+    File file = ESP_FS.open(IMAGE_INDEX_FILENAME, "r+");
+    int32_t pos;
+    bool ok;
+
+    if(!file)   return false;
+    pos = find_record(file, filename, &record);
+    fill_record(&record, filename, info, size);
+    if(pos >= 0)
+        ok = write_record(file, pos, &record);
+    else
+        ok = write_record(file, index_count, &record) && write_header(file, index_count+1);
+    file.close();
+    return ok;
+}
+
+void image_index_remove(const char *filename)
+{
+    struct imageIndexRecord record;
+    File file = ESP_FS.open(IMAGE_INDEX_FILENAME, "r+");
+    int32_t pos;
+
+    if(!file)   return;
+    pos = find_record(file, filename, &record);
+    if(pos >= 0)
+    {   // move the last record into the gap
+        if((uint32_t)pos != index_count-1)
+        {
+            if(file.seek(record_offset(index_count-1), SeekSet) &&
+               (file.read((uint8_t *)&record, sizeof(record)) == sizeof(record)))
+                write_record(file, pos, &record);
+        }
+        write_header(file, index_count-1);
+    }
+    file.close();
+}
@@ -0,0 +1,43 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+imageindex.h - persistent index of the displayable images on the filesystem
+
+listings and the slideshow read this instead of walking the directory and checking every file:
+fixed size records in a file, so any image can be found by its position without reading the others.
+the index is updated whenever a file is stored or deleted; scan_images_for_slideshow() rebuilds it.
+
+*/
+
+#ifndef IMAGEINDEX_H
+#define IMAGEINDEX_H
+
+#include "gfxsniff.h"
+
+#define IMAGE_INDEX_FILENAME    "/images.idx"
+
+struct imageIndexRecord
+{
+    char filename[MAX_FILENAME_LEN+1];
+    uint8_t type;       // GFI_TYPE
+    uint8_t depth;      // bits per pixel
+    uint16_t width;
+    uint16_t height;
+    uint32_t size;      // of the file, in bytes
+};
+
+bool image_index_begin(void);           // read the index; false, if there is no valid one (=> rebuild it)
+bool image_index_clear(void);           // start a new, empty index
+uint32_t image_index_count(void);       // number of images in the index
+
+// read the record at pos (0..image_index_count()-1); false, if there is none
+bool image_index_get(uint32_t pos, struct imageIndexRecord *record);
+// add an image (replacing a record of the same name) - image_index_append() does not check for that
+bool image_index_add(const char *filename, const struct gfxFileInfo *info, uint32_t size);
+bool image_index_append(const char *filename, const struct gfxFileInfo *info, uint32_t size);
+// remove an image; the last record takes its position
+void image_index_remove(const char *filename);
+
+#endif IMAGEINDEX_H
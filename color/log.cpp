@@ -0,0 +1,96 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+log.cpp - diagnostic messages: leveled, filtered at compile time, buffered in RAM - implementation
+
+The ring buffer is addressed by the total count of bytes ever written (log_written); older data is simply
+overwritten. The HTTP handlers log, too, from a task of their own: the buffer is accessed in (short)
+critical sections only, never while formatting or sending.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include <stdarg.h>
+#include "esplayer.h"
+#include "log.h"
+
+#define LOG_LINE_SIZE   160     // longer messages are cut
+
+static char log_buffer[LOG_BUFFER_SIZE];
+static uint32_t log_written = 0;    // bytes ever written; the position is log_written % LOG_BUFFER_SIZE
+static uint32_t log_sent = 0;       // bytes ever sent to the serial port
+
+static const char log_level_letters[] = "-EWID";
+
+void log_printf(uint8_t level, const char *format, ...)
+{
+    char line[LOG_LINE_SIZE];
+    va_list args;
+    int len;
+
+    len = snprintf(line, sizeof(line), "%8lu %c ", millis(), log_level_letters[level]);
+    va_start(args, format);
+    vsnprintf(line+len, sizeof(line)-len-1, format, args);  // -1: room for '\n'
+    va_end(args);
+    len = strlen(line);
+    line[len++] = '\n';
+
+    esp_enter_critical();
+    for(int i = 0; i < len; ++i)
+        log_buffer[(log_written++) % LOG_BUFFER_SIZE] = line[i];
+    esp_exit_critical();
+}
+
+bool log_drain(void)
+{
+    char chunk[64];
+    uint32_t len, room = Serial.availableForWrite();
+
+    while(room)
+    {
+        esp_enter_critical();
+        if(log_written - log_sent > LOG_BUFFER_SIZE)    log_sent = log_written - LOG_BUFFER_SIZE;  // overwritten meanwhile: lost
+        len = log_written - log_sent;
+        if(len > sizeof(chunk)) len = sizeof(chunk);
+        if(len > room)          len = room;
+        for(uint32_t i = 0; i < len; ++i)
+            chunk[i] = log_buffer[(log_sent+i) % LOG_BUFFER_SIZE];
+        log_sent += len;
+        esp_exit_critical();
+
+        if(!len)    break;
+        Serial.write((const uint8_t *)chunk, len);
+        room -= len;
+    }
+    return log_written != log_sent;     // (no critical section needed: just a hint when to try again)
+}
+
+void log_print(Print &out)
+{
+    char chunk[256];
+    uint32_t pos, end, len;
+
+    esp_enter_critical();
+    end = log_written;      // what is logged while sending is not sent any more
+    pos = (end > LOG_BUFFER_SIZE) ? end - LOG_BUFFER_SIZE : 0;
+    esp_exit_critical();
+
+    for(;;)
+    {
+        esp_enter_critical();
+        if(log_written - pos > LOG_BUFFER_SIZE) pos = log_written - LOG_BUFFER_SIZE;   // overwritten while sending
+        len = (end > pos) ? end - pos : 0;
+        if(len > sizeof(chunk)) len = sizeof(chunk);
+        for(uint32_t i = 0; i < len; ++i)
+            chunk[i] = log_buffer[(pos+i) % LOG_BUFFER_SIZE];
+        pos += len;
+        esp_exit_critical();
+
+        if(!len)    break;
+        out.write((const uint8_t *)chunk, len);
+    }
+}
@@ -0,0 +1,53 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+log.h - diagnostic messages: leveled, filtered at compile time, buffered in RAM
+
+LOG_ERROR(), LOG_WARN(), LOG_INFO() and LOG_DEBUG() take printf()-like arguments. The levels above
+LOG_LEVEL (config.h) expand to nothing, the arguments are not even evaluated. The messages are written
+to a ring buffer - never waiting for the serial port; log_drain() sends what is new when there is time
+(from loop()) and the buffer is shown at /log.
+
+*/
+
+#ifndef LOG_H
+#define LOG_H
+
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3
+#define LOG_LEVEL_DEBUG     4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL           LOG_LEVEL_INFO
+#endif
+
+void log_printf(uint8_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+bool log_drain(void);               // send (part of) what is new to the serial port - without waiting for it; true: more is left
+void log_print(Print &out);         // the whole buffer, oldest first
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...)  log_printf(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...)  do {} while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...)   log_printf(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...)   do {} while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...)   log_printf(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...)   do {} while(0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...)  log_printf(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...)  do {} while(0)
+#endif
+
+#endif LOG_H
@@ -18,14 +18,53 @@ network.cpp - network (WiFi, HTTP-UI) related stuff, implementation
 extern UCG_DECLARATION;
 #include "gfxlayer.h"
 #include "bitmap.h"
+#include "gfxsniff.h"
+#include "imageindex.h"
+#include "imagecache.h"
+#include "render.h"
+#include "metrics.h"
+#include "log.h"
+#include "slideshow.h"
+#include "stream.h"
 #include <JPEGDecoder.h>    // https://github.com/Bodmer/JPEGDecoder
 
 /*********************************************************************/
-// "imported" from the main sketch:
-extern bool slideshow_is_running;
-extern unsigned long slideshow_last_switch;
-extern int slideshow_current_index;
-void drawAnyImageType(const char *filename);
+// the webserver works asynchronously: the handlers are called by the TCP stack (ESP32: in a task of
+// its own, ESP8266: in the system context) and serve several clients concurrently - they must not
+// block. So anything slow (drawing, formatting, WiFi reconfiguration, reboot) is just ordered by a
+// handler and done by processNetworkActions(), called from loop().
+// So is any change of what loop() uses meanwhile: the settings, the files shown (deleting, replacing
+// by a completed upload), the image index (the slideshow walks it by position) and the image cache.
+
+#define ACTION_DISPLAY      1   // draw pending_display_filename
+#define ACTION_CLEAR        2   // clear the display
+#define ACTION_SHOW_WIFI    4   // show the WiFi info on the display
+#define ACTION_FORMAT_FS    8   // format the filesystem
+#define ACTION_CONNECT_STA  16  // (try to) connect to the WiFi configured in MySettings
+#define ACTION_REBOOT       32
+#define ACTION_RESCAN_IMAGES 64 // rebuild the image index
+#define ACTION_SETTINGS     128 // take over pending_settings
+#define ACTION_SAVE_SETTINGS 256    // ... and save them
+#define ACTION_FILE_CHANGES 512 // do the file_changes queued
+
+static volatile uint16_t pending_actions = 0;
+static char pending_display_filename[MAX_FILENAME_LEN+1];
+static struct EEPromData pending_settings;
+
+#define FILE_CHANGE_DELETE  1   // delete filename
+#define FILE_CHANGE_RENAME  2   // an upload is complete: rename from (its temporary file) to filename, (if it is an image) index it
+
+#define FILE_CHANGES        16  // queued at most (a tar archive of small files may fill the queue faster than loop() empties it)
+
+static struct fileChange
+{
+    uint8_t change;
+    char filename[MAX_FILENAME_LEN+1];
+    char from[MAX_FILENAME_LEN+1];
+    struct gfxFileInfo info;    // _RENAME: the image (type GFI_TYPE_INVALID: no image)
+    uint32_t size;
+} file_changes[FILE_CHANGES];
+static uint8_t file_changes_first = 0, file_changes_count = 0;
 /*********************************************************************/
 
 // what links can be excluded from the footer?
@@ -33,21 +72,6 @@ void drawAnyImageType(const char *filename);
 #define LINK_FILEMANAGER    2
 #define LINK_SETTINGS       3
 
-/*********************************************************************/
-// data a) scanned from some (potential) gfx file to determine if it can be displayed
-// and b) returned to some "listing" function to display general info on that file
-
-enum GFI_TYPE { GFI_TYPE_INVALID, GFI_TYPE_BMP, GFI_TYPE_JPG, GFI_TYPE_GIF, GFI_TYPE_PNG };
-
-struct gfxFileInfo
-{
-    GFI_TYPE type;
-    uint32_t width;
-    uint32_t height;
-    uint16_t depth; // bits per pixel
-};
-/*********************************************************************/
-
 // CSS is used several times:
 static const char *css_definition = "<style type='text/css'><!-- * {font-family:sans-serif;} "
         "DIV.container {min-height: 10em; display: table-cell; vertical-align: middle} "
@@ -78,8 +102,6 @@ IPAddress netMsk(255, 255, 255, 0);
 // Current WiFi status
 short status = WL_IDLE_STATUS;
 
-int slideshow_num_images = 0;
-char slideshow_filenames[SLIDESHOW_MAX_IMAGES][MAX_FILENAME_LEN+1];
 
 boolean CreateWifiSoftAP(void)
 {
@@ -186,33 +208,137 @@ char *urlencode(char const *from)
     return buffer;
 }
 
+// order some action to be done by processNetworkActions()
+static void orderAction(uint8_t action)
+{
+    esp_enter_critical();
+    pending_actions |= action;
+    esp_exit_critical();
+    esp_signal_event();     // wake up loop()
+}
+
+// order an image to be drawn by processNetworkActions() (overrides a pending clear/draw)
+static void orderDisplay(const char *filename)
+{
+    esp_enter_critical();
+    strncpy(pending_display_filename, filename, MAX_FILENAME_LEN);
+    pending_display_filename[MAX_FILENAME_LEN] = '\0';
+    pending_actions = (pending_actions & ~ACTION_CLEAR) | ACTION_DISPLAY;
+    esp_exit_critical();
+    esp_signal_event();
+}
+
+// the settings as a handler is to change them: as ordered, if not taken over yet
+static void copySettings(struct EEPromData *settings)
+{
+    esp_enter_critical();
+    *settings = (pending_actions & ACTION_SETTINGS) ? pending_settings : MySettings;
+    esp_exit_critical();
+}
+
+// order settings to be taken over by processNetworkActions(), along with further actions
+static void orderSettings(const struct EEPromData *settings, uint16_t actions)
+{
+    esp_enter_critical();
+    pending_settings = *settings;
+    pending_actions |= ACTION_SETTINGS | actions;
+    esp_exit_critical();
+    esp_signal_event();
+}
+
+// order a change of a file (see FILE_CHANGE_...) to be done by processNetworkActions(); false, if the queue is full
+static bool orderFileChange(uint8_t change, const char *filename, const struct gfxFileInfo *info = NULL, uint32_t size = 0, const char *from = "")
+{
+    struct fileChange *fc;
+
+    esp_enter_critical();
+    if(file_changes_count == FILE_CHANGES)
+    {
+        esp_exit_critical();
+        return false;
+    }
+    fc = &file_changes[(file_changes_first + file_changes_count++) % FILE_CHANGES];
+    fc->change = change;
+    strncpy(fc->filename, filename, MAX_FILENAME_LEN);
+    fc->filename[MAX_FILENAME_LEN] = '\0';
+    strncpy(fc->from, from, MAX_FILENAME_LEN);
+    fc->from[MAX_FILENAME_LEN] = '\0';
+    fc->info.type = GFI_TYPE_INVALID;
+    if(info)    fc->info = *info;
+    fc->size = size;
+    pending_actions |= ACTION_FILE_CHANGES;
+    esp_exit_critical();
+    esp_signal_event();
+    return true;
+}
+
+// do the file changes queued - in loop()
+static void processFileChanges(void)
+{
+    struct fileChange fc;
+
+    for(;;)
+    {
+        esp_enter_critical();
+        if(!file_changes_count)
+        {
+            esp_exit_critical();
+            return;
+        }
+        fc = file_changes[file_changes_first];
+        file_changes_first = (file_changes_first + 1) % FILE_CHANGES;
+        --file_changes_count;
+        esp_exit_critical();
+
+        switch(fc.change)
+        {
+            case FILE_CHANGE_DELETE:
+                ESP_FS.remove(fc.filename);
+                image_index_remove(fc.filename);
+                break;
+            case FILE_CHANGE_RENAME:
+                // from missing: renamed by an earlier change already - with this content, if the same temporary
+                // file was written again meanwhile (completed twice, a name repeated in an archive)
+                if(ESP_FS.exists(fc.from))
+                {
+                    if(ESP_FS.exists(fc.filename))  ESP_FS.remove(fc.filename);
+                    ESP_FS.rename(fc.from, fc.filename);
+                }
+                if(fc.info.type != GFI_TYPE_INVALID)    image_index_add(fc.filename, &fc.info, fc.size);
+                break;
+        }
+        image_cache_changed();  // (a cached image of that name is outdated)
+    }
+}
+
 // send some default "headers" forbidding caching - etc!
 // redirection *may* be ordered
-void httpHeaders(char *redirect = NULL)
+void httpHeaders(AsyncWebServerResponse *response, const char *redirect = NULL)
 {
-    if(redirect && *redirect)   server.sendHeader("Location", redirect, true);
-    server.sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
-    server.sendHeader("Pragma", "no-cache");
-    server.sendHeader("Expires", "-1");
-    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    if(redirect && *redirect)   response->addHeader("Location", redirect);
+    response->addHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+    response->addHeader("Pragma", "no-cache");
+    response->addHeader("Expires", "-1");
 }
 
 // redirect to the "main" page via http:
-void redirectMain(void)
+void redirectMain(AsyncWebServerRequest *request)
 {
-    httpHeaders("/");
-    server.send(302, "text/plain", "");     // Empty content inhibits Content-length header so we have to close the socket ourselves.
-    server.client().stop();                 // Stop is needed because we sent no content length
+    AsyncWebServerResponse *response = request->beginResponse(302, "text/plain", "");
+    httpHeaders(response, "/");
+    request->send(response);
 }
 
-// send some default "headers" forbidding caching, set content type to text/html, 
-// send common opening of the HTML page, including CSS & Title - as <title> & <h2>...
-void openHtml(char *label)
+// start a HTML page: create a response stream (collecting the page, sent with a known length - the
+// asynchronous server closes the connection after each response anyway), set default "headers" forbidding caching,
+// add common opening of the HTML page, including CSS & Title - as <title> & <h2>...
+AsyncResponseStream *openHtml(AsyncWebServerRequest *request, const char *label)
 {
+    AsyncResponseStream *response = request->beginResponseStream("text/html");
     String temp;
-    
-    httpHeaders();
-    
+
+    httpHeaders(response);
+
     // HTML Content
     temp  = "<!DOCTYPE HTML><html lang='de'><head><meta charset='UTF-8'><meta name= viewport content='width=device-width, initial-scale=1.0,'>";
     temp += css_definition;
@@ -221,12 +347,13 @@ void openHtml(char *label)
     else        label = PROJECT_TITLE;
     temp += "</title></head>";
     temp += String("<body><h2>") + label + "</h2>";
-    server.send(200, "text/html", temp);
+    response->print(temp);
+    return response;
 }
 
-// add the footer with the links, copyright etc., close the HTML doc and server.client().stop()
+// add the footer with the links, copyright etc., close the HTML doc and send the response
 // exclude_what can be used to suppress the link to the page just displayed
-void finishHTML(int exclude_what)
+void finishHTML(AsyncWebServerRequest *request, AsyncResponseStream *response, int exclude_what)
 {
     String temp;
   
@@ -234,117 +361,625 @@ void finishHTML(int exclude_what)
     if(exclude_what != LINK_MAIN)        temp += "<a href='/'>Main Page</a><br><br>";
     if(exclude_what != LINK_SETTINGS)    temp += "<a href='/settings'>Settings</a><br><br>";
     if(exclude_what != LINK_FILEMANAGER) temp += "<a href='/filesystem'>Filemanager</a><br><br>";
-    if(slideshow_num_images > 1)
+    if(image_index_count() > 1)
     {
-        temp += slideshow_is_running ? "<a href='/slideshow?off=1'>stop slideshow</a><br><br>" : "<a href='/slideshow?on=1'>start slideshow</a><br><br>";
+        temp += slideshow_running() ? "<a href='/slideshow?off=1'>stop slideshow</a><br><br>" : "<a href='/slideshow?on=1'>start slideshow</a><br><br>";
     }
     temp += "<a href='/showwifi'>show WiFi info (like on startup; on the display)</a><br>";
-    server.sendContent(temp);
+    response->print(temp);
     temp = String("</td></tr></table><br>") + html_footer + "</body></html>";
-    server.sendContent(temp);
-    server.client().stop(); // Stop is needed because we sent no content length
+    response->print(temp);
+    request->send(response);
     temp = "";
 }
 
-void handleFileUpload(void)
+// can an image with this info be displayed? (on a video wall, it may be as large as the whole wall)
+static bool gfxFileDisplayable(const struct gfxFileInfo *info)
+{
+    return render_fits(info->width, info->height);
+}
+
+// state of the (single) running upload - it belongs to request until that is answered
+static struct
+{
+    AsyncWebServerRequest *request;     // the request uploading - only one upload at a time
+    bool receiving;                     // its data is still arriving
+    const char *error;                  // why the (last) file was rejected, for the response; NULL: OK
+    int status;                         // resumable upload: the HTTP status code of error
+    String target;                      // the name of the file uploaded
+    String filename;                    // the file currently written: a temporary one, renamed to target when complete
+    File file;                          // opened with the first write to the filesystem
+    bool rejected;                      // the rest of the current file is to be ignored
+    bool append;                        // resumable upload: append to the file, keep the data on an abort
+    struct gfxSniffer sniffer;          // checks image headers while they arrive
+    size_t fill;                        // bytes used in buffer
+    uint8_t buffer[UPLOAD_BUFFER_SIZE];
+} upload;
+
+// write the buffered data to the file (opening it, if not done yet)
+static bool uploadFlush(void)
+{
+    if(!upload.fill)    return true;
+    if(!upload.file)
+    {
+        upload.file = ESP_FS.open(upload.filename, upload.append ? "a" : "w");
+        if(!upload.file)    return false;
+    }
+    if(upload.file.write(upload.buffer, upload.fill) != upload.fill)  return false;
+    upload.fill = 0;
+    return true;
+}
+
+// stop writing the current file: remove what has been written so far and ignore the rest
+// (just the temporary file - a file of the target's name stays as it was)
+static void uploadReject(const char *reason)
+{
+    if(upload.file)
+    {
+        upload.file.close();
+        ESP_FS.remove(upload.filename);
+    }
+    upload.fill = 0;
+    upload.rejected = true;
+    upload.error = reason;
+}
+
+// check the image header (as far as received); rejects the file as soon as the image is known to be unusable
+static void uploadSniff(const uint8_t *data, size_t len)
+{
+    if(upload.sniffer.result != SNIFF_MORE)     return;
+    switch(sniff_feed(&upload.sniffer, data, len))
+    {
+        case SNIFF_INVALID:
+            uploadReject("unsupported image format");
+            break;
+        case SNIFF_OK:
+            if(!gfxFileDisplayable(&upload.sniffer.info))
+                uploadReject("image larger than the display (or video wall)");
+            break;
+        default:    ;   // header not complete yet
+    }
+}
+
+// size of a file; 0, if it does not exist
+static size_t fileSize(const String &filename)
+{
+    size_t size = 0;
+    if(ESP_FS.exists(filename))
+    {
+        File file = ESP_FS.open(filename, "r");
+        size = file.size();
+        file.close();
+    }
+    return size;
+}
+
+// the free space on the filesystem, counting a file about to be overwritten (a left over temporary one) as free
+static size_t uploadAvailable(const String &filename)
+{
+    return esp_get_fs_totalBytes() - esp_get_fs_usedBytes() + fileSize(filename);
+}
+
+// the name an uploaded file gets: shortened to what the filesystem takes, with a leading '/'
+static String uploadFileName(String filename, uint8_t maxlen = 30)
+{
+    if (filename.length() > maxlen) {
+        filename = filename.substring(filename.length() - maxlen, filename.length());  // shorten filename to maxlen (30) chars
+    }
+    if (!filename.startsWith("/")) filename = "/" + filename;
+    return filename;
+}
+
+// the temporary file an upload is written to (shorter than the final name to leave room for the suffix):
+// loop() may draw the file of the final name meanwhile - or keeps it, if the upload is rejected
+static String uploadTempName(const String &filename)
 {
-    static File fsUploadFile;           // a File object to temporarily store the received file
+    return uploadFileName(filename, 26) + ".tmp";
+}
+
+// check the content as an image of type (no image type: nothing to check)
+static void uploadSniffBegin(GFI_TYPE type)
+{
+    sniff_begin(&upload.sniffer, type);
+    if(upload.sniffer.result == SNIFF_INVALID)  // no image => nothing to check
+        upload.sniffer.result = SNIFF_OK;
+}
+
+// start writing a file - to its temporary file
+static void uploadFileBegin(const String &filename)
+{
+    upload.target   = uploadFileName(filename);
+    upload.filename = uploadTempName(filename);
+    upload.rejected = false;
+    upload.append   = false;
+    upload.fill     = 0;
+    uploadSniffBegin(gfxTypeFromFilename(upload.target.c_str()));
+}
 
-    if (server.uri() != "/upload") return;
-//Serial.print(millis());
-//Serial.print(": handleFileUpload(), ");
-    HTTPUpload& upload = server.upload();
-    if (upload.status == UPLOAD_FILE_START)
+// the next piece of the current file
+static void uploadFileData(const uint8_t *data, size_t len)
+{
+    while (len && !upload.rejected)
     {
-//Serial.print("UPLOAD_FILE_START, filename ~ ");
-        String filename = upload.filename;
-        if (filename.length() > 30) {
-            filename = filename.substring(filename.length() - 30, filename.length());  // shorten filename to 30 chars
+        size_t n = UPLOAD_BUFFER_SIZE - upload.fill;
+        if (n > len)  n = len;
+        uploadSniff(data, n);
+        if (upload.rejected)  break;
+        memcpy(upload.buffer + upload.fill, data, n);
+        upload.fill += n;
+        data += n;
+        len  -= n;
+        if (upload.fill == UPLOAD_BUFFER_SIZE && !uploadFlush())
+            uploadReject("writing to the filesystem failed");
+    }
+}
+
+// the current file is complete: its temporary file is renamed by processNetworkActions(); returns false, if it was rejected
+static bool uploadFileEnd(void)
+{
+    if (!upload.rejected)
+    {
+        if (upload.sniffer.result == SNIFF_MORE)    // ended within the header
+            uploadReject("image file truncated");
+        else if (!uploadFlush())
+            uploadReject("writing to the filesystem failed");
+        else
+        {
+            if (!upload.file)   // empty file: create it anyway
+                upload.file = ESP_FS.open(upload.filename, "w");
+            upload.file.close();
+            if (!orderFileChange(FILE_CHANGE_RENAME, upload.target.c_str(), &upload.sniffer.info, fileSize(upload.filename), upload.filename.c_str()))
+            {
+                ESP_FS.remove(upload.filename);
+                upload.rejected = true;
+                upload.error = "too many files at once, upload it again";
+            }
         }
-//Serial.println("FileUpload Name: " + filename);
-        if (!filename.startsWith("/")) filename = "/" + filename;
-        fsUploadFile = SPIFFS.open(server.urlDecode(filename), "w");
-        filename = String();
     }
-    else if (upload.status == UPLOAD_FILE_WRITE)
+    return !upload.rejected;
+}
+
+// claim the (single) upload slot for request; false, if some other upload is still running (or not answered yet):
+// request is refused then - marked by the library's per-request pointer (freed with the request), so its response
+// handler answers 409 without touching the running upload
+static bool uploadStart(AsyncWebServerRequest *request)
+{
+    if(upload.request)
+    {
+        if(!request->_tempObject)   request->_tempObject = malloc(1);
+        return false;
+    }
+    upload.request   = request;
+    upload.receiving = true;
+    upload.error     = NULL;
+    request->onDisconnect([request]() {     // answered - or aborted while uploading
+        if (upload.request != request)  return;
+        if (!upload.receiving || upload.rejected)   ;
+        else if (!upload.append)  uploadReject("upload aborted");
+        else if (uploadFlush() && upload.file)  upload.file.close();    // the data received so far is fine for resuming
+        else  uploadReject("writing to the filesystem failed");
+        upload.request = NULL;
+    });
+    return true;
+}
+
+// was request refused by uploadStart()?
+static bool uploadRefused(AsyncWebServerRequest *request)
+{
+    return request->_tempObject != NULL;
+}
+
+// called for each piece of an upload; index: offset of data within the file, final: last piece
+void handleFileUpload(AsyncWebServerRequest *request, const String &upload_filename, size_t index, uint8_t *data, size_t len, bool final)
+{
+    if (index == 0)
     {
-//Serial.print("UPLOAD_FILE_WRITE, size: ");
-//Serial.println(upload.currentSize);
-        if (fsUploadFile)  fsUploadFile.write(upload.buf, upload.currentSize);
+        if(!uploadStart(request))   return;
+//Serial.println("FileUpload Name: " + upload_filename);
+        uploadFileBegin(request->urlDecode(upload_filename));
+        // Content-Length covers the multipart framing, too => slightly pessimistic, which is fine
+        if(request->contentLength() > uploadAvailable(upload.filename))
+            uploadReject("not enough space on the filesystem");
     }
-    else if (upload.status == UPLOAD_FILE_END)
+    if (request != upload.request)  return;
+    uploadFileData(data, len);
+    if (final)
     {
-//Serial.println("UPLOAD_FILE_END");
-        if (fsUploadFile)  fsUploadFile.close();
-        handleDisplayFS();
+//Serial.println("upload end");
+        uploadFileEnd();
+        upload.receiving = false;
     }
+}
+
+// the response to a POST on /upload - sent once, after handleFileUpload() has seen the whole upload
+void handleUploadDone(AsyncWebServerRequest *request)
+{
+    const char *error = uploadRefused(request) ? "another upload is running" :
+                        (request == upload.request) ? upload.error : NULL;
+
+    if(error)
+    {
+        AsyncResponseStream *response = openHtml(request, "Upload rejected");
+        if(uploadRefused(request))  response->setCode(409);
+        response->print(error);
+        finishHTML(request, response, 0);
+    }
+    else handleDisplayFS(request);
+}
+
+/*********************************************************************/
+// archive upload: a tar stream is unpacked to the filesystem while it arrives.
+// only regular files are stored (directories within the names are dropped - the filesystem is flat);
+// unusable images are skipped without affecting the others.
+
+#define TAR_BLOCK   512
+
+static struct
+{
+    uint8_t header[TAR_BLOCK];
+    size_t  hfill;          // bytes collected in header
+    size_t  remaining;      // bytes of the current entry's data still to come
+    size_t  padding;        // bytes to skip up to the next block boundary after the data
+    bool    in_file;        // the data is written to the filesystem (else skipped)
+    bool    done;           // end-of-archive (an empty block) seen or archive corrupt
+    uint16_t stored;
+    uint16_t skipped;
+    const char *error;      // reason for the last skipped entry
+} tar;
+
+// a numeric header field: octal ASCII, space/NUL terminated
+static uint32_t tarNumber(const uint8_t *field, uint8_t len)
+{
+    uint32_t value = 0;
+    while(len && (*field == ' '))   { ++field; --len; }
+    while(len && (*field >= '0') && (*field <= '7'))
+    {
+        value = (value << 3) | (*field++ - '0');
+        --len;
+    }
+    return value;
+}
+
+// a complete header block was collected: check it and start the entry
+static void tarHeader(void)
+{
+    const uint8_t *h = tar.header;
+    uint32_t checksum = 0;
+    uint16_t i;
+    char name[101];
+    const char *base;
+
+    for(i=0; i<TAR_BLOCK; i++)  checksum += ((i >= 148) && (i < 156)) ? ' ' : h[i];
+    if(checksum == 8*' ')       // all zero: end of archive
+    {
+        tar.done = true;
+        return;
+    }
+    if(checksum != tarNumber(h+148, 8))
+    {
+        tar.error = "archive corrupt";
+        tar.done = true;
+        return;
+    }
+    tar.remaining = tarNumber(h+124, 12);
+    tar.padding   = (TAR_BLOCK - (tar.remaining % TAR_BLOCK)) % TAR_BLOCK;
+    tar.in_file   = false;
+    if((h[156] != '0') && (h[156] != '\0'))     // no regular file (directory, link, extended header...)
+        return;
+
+    memcpy(name, h, 100);
+    name[100] = '\0';
+    base = strrchr(name, '/');
+    base = base ? base+1 : name;
+    if(!*base || (*base == '.'))    // no name or hidden (like "._" files of MacOS tar)
+        return;
+    uploadFileBegin(base);
+    if(tar.remaining > uploadAvailable(upload.filename))
+        uploadReject("not enough space on the filesystem");
+    tar.in_file = true;
+}
+
+// the current entry's data is complete
+static void tarEndFile(void)
+{
+    if(!tar.in_file)    return;
+    if(uploadFileEnd())
+        ++tar.stored;
     else
     {
-//if (upload.status == UPLOAD_FILE_END) Serial.println("UPLOAD_FILE_ABORTED");
-//else{
-//Serial.print("*unexpected* upload.status = ");
-//Serial.println(upload.status);
-//}
+        ++tar.skipped;
+        tar.error = upload.error;
+    }
+    tar.in_file = false;
+}
 
-        if (fsUploadFile)  fsUploadFile.close();
+// feed the next piece of the archive
+static void tarFeed(const uint8_t *data, size_t len)
+{
+    while(len && !tar.done)
+    {
+        size_t n;
+
+        if(tar.remaining)
+        {   // entry data
+            n = (len < tar.remaining) ? len : tar.remaining;
+            if(tar.in_file) uploadFileData(data, n);
+            tar.remaining -= n;
+            if(!tar.remaining)  tarEndFile();
+        }
+        else if(tar.padding)
+        {
+            n = (len < tar.padding) ? len : tar.padding;
+            tar.padding -= n;
+        }
+        else
+        {   // header
+            n = TAR_BLOCK - tar.hfill;
+            if(n > len) n = len;
+            memcpy(tar.header + tar.hfill, data, n);
+            tar.hfill += n;
+            if(tar.hfill == TAR_BLOCK)
+            {
+                tar.hfill = 0;
+                tarHeader();
+                if(!tar.remaining)  tarEndFile();  // empty file
+            }
+        }
+        data += n;
+        len  -= n;
+    }
+}
 
-        openHtml((char *)((upload.status == UPLOAD_FILE_END) ? "Upload aborted" : ("Stale upload, unknown status "+String(upload.status)).c_str()));
-        finishHTML(0);
+static void tarBegin(void)
+{
+    memset(&tar, 0, sizeof(tar));
+}
+
+// raw body (Content-Type: application/x-tar), e.g. by curl --data-binary
+void handleTarBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    if(index == 0)
+    {
+        if(!uploadStart(request))   return;
+        tarBegin();
+    }
+    if(request != upload.request)   return;
+    tarFeed(data, len);
+    if(index + len >= total)
+    {
+        if(tar.remaining && tar.in_file)    // archive ended within an entry: keep nothing of it
+            uploadReject("archive truncated");
+        tarEndFile();
+        upload.receiving = false;
     }
 }
 
-void handleDisplayFS(void)                       //  Page: /filesystem
+// multipart form upload of an archive (by the file manager page)
+void handleTarUpload(AsyncWebServerRequest *request, const String &upload_filename, size_t index, uint8_t *data, size_t len, bool final)
 {
-Serial.println("handleDisplayFS()");
+    handleTarBody(request, data, len, index, final ? index+len : (size_t)-1);
+}
+
+// the response to a POST on /upload_tar, after the whole archive was processed
+void handleTarDone(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response;
+    String temp;
+
+    if(request != upload.request)
+    {   // did not even start (empty or some other upload running)
+        handleUploadDone(request);
+        return;
+    }
+    response = openHtml(request, "Archive upload");
+    temp = String(tar.stored) + " files stored, " + tar.skipped + " skipped.";
+    if(tar.error)   temp += String("<br>") + (tar.skipped ? "Last reason for skipping: " : "") + tar.error;
+    response->print(temp);
+    finishHTML(request, response, 0);
+}
+/*********************************************************************/
+
+/*********************************************************************/
+// resumable upload: a file is sent as raw body in pieces, POST /upload_chunk?name=<file>&offset=<n>[&total=<size>]
+// each piece is appended to a partial file "<file>.part" - offset must be its current size (else: 409, the body says the size).
+// GET /upload_chunk?name=<file> tells that size, so an interrupted upload continues where it stopped.
+// when the partial file reaches total, it is renamed to <file>; one longer than total is removed (409, size 0) -
+// unless another upload is appending to it (409, its size).
+
+// the partial file of a resumable upload (shorter than the final name to leave room for the suffix)
+static String chunkPartName(const String &name)
+{
+    return uploadFileName(name, 25) + ".part";
+}
+
+// a size given as argument (toInt() is signed)
+static size_t chunkArgSize(AsyncWebServerRequest *request, const char *name)
+{
+    return strtoul(request->arg(name).c_str(), NULL, 10);
+}
+
+void handleChunkBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    if(index == 0)
+    {
+        String name = request->arg("name");
+        size_t offset = chunkArgSize(request, "offset"),
+               total  = chunkArgSize(request, "total");
+
+        if(!uploadStart(request))   return;
+        uploadFileBegin(name);
+        upload.filename = chunkPartName(name);  // (kept between the pieces, renamed by handleChunkDone())
+        upload.append = true;
+        // the image header is checked with the first piece; later pieces just continue the file
+        uploadSniffBegin(offset ? GFI_TYPE_INVALID : gfxTypeFromFilename(name.c_str()));
+        upload.status = 422;     // for rejections by the content check
+        if(!name.length())
+        {
+            upload.status = 400;
+            uploadReject("name missing");
+        }
+        else if(offset != fileSize(upload.filename))
+        {
+            upload.status = 409;
+            uploadReject("offset does not match the partial file");
+        }
+        else if(request->hasArg("total") && (offset + request->contentLength() > total))
+        {
+            upload.status = 409;
+            uploadReject("more data than total");
+        }
+        else if((total > offset) && (total - offset > esp_get_fs_totalBytes() - esp_get_fs_usedBytes()))
+        {
+            upload.status = 507;
+            uploadReject("not enough space on the filesystem");
+        }
+    }
+    if(request != upload.request)   return;
+    uploadFileData(data, len);
+    if(index + len >= total)
+    {
+        if(upload.rejected) ;
+        else if(!uploadFlush())
+        {
+            upload.status = 500;
+            uploadReject("writing to the filesystem failed");
+        }
+        else if(upload.file)    upload.file.close();
+        upload.receiving = false;
+    }
+}
+
+// response to GET/POST on /upload_chunk: the size of the partial file (after appending)
+void handleChunkDone(AsyncWebServerRequest *request)
+{
+    String name = request->arg("name");
+    String partname = chunkPartName(name);
+    size_t size, total = chunkArgSize(request, "total");
+    // the running upload (of another request, e.g. when this one just asks for the size) appends to the partial file:
+    // it is neither removed nor completed meanwhile
+    bool in_use = upload.request && (upload.request != request) && (upload.filename == partname);
+
+    // the size helps to get in sync again
+    if(uploadRefused(request))
+    {
+        request->send(409, "text/plain", String("another upload is running\n") + fileSize(partname) + "\n");
+        return;
+    }
+    if(request->hasArg("total") && (fileSize(partname) > total))
+    {   // (left over from some other upload?) it can't become the file: start anew
+        if(in_use)
+        {
+            request->send(409, "text/plain", String("partial file longer than total, in use by another upload\n") + fileSize(partname) + "\n");
+            return;
+        }
+        ESP_FS.remove(partname);
+        request->send(409, "text/plain", "partial file longer than total, removed\n0\n");
+        return;
+    }
+    if((request == upload.request) && upload.error)
+    {
+        request->send(upload.status, "text/plain", String(upload.error) + "\n" + fileSize(partname) + "\n");
+        return;
+    }
+    if(!name.length())
+    {
+        request->send(400, "text/plain", "name missing\n");
+        return;
+    }
+    size = fileSize(partname);
+    if(in_use && (request->method() == HTTP_POST))
+    {
+        request->send(409, "text/plain", String("another upload is running\n") + size + "\n");
+        return;
+    }
+    if((request->method() == HTTP_POST) && request->hasArg("total") && (size == total))
+    {   // complete: checked here, renamed by processNetworkActions() (the file may be shown meanwhile)
+        String filename = uploadFileName(name);
+        GFI_TYPE type = gfxTypeFromFilename(filename.c_str());
+        struct gfxFileInfo info;
+
+        info.type = GFI_TYPE_INVALID;
+        if((type != GFI_TYPE_INVALID) &&
+           !(sniffFileAs(partname.c_str(), type, &info) && gfxFileDisplayable(&info)))
+        {
+            ESP_FS.remove(partname);
+            request->send(422, "text/plain", "unsupported image\n");
+            return;
+        }
+        if(!orderFileChange(FILE_CHANGE_RENAME, filename.c_str(), &info, size, partname.c_str()))
+        {
+            request->send(503, "text/plain", String("busy, complete again later\n") + size + "\n");
+            return;
+        }
+        request->send(201, "text/plain", String(size) + "\n");
+        return;
+    }
+    request->send(200, "text/plain", String(size) + "\n");
+}
+/*********************************************************************/
+
+void handleDisplayFS(AsyncWebServerRequest *request)     //  Page: /filesystem
+{
+  LOG_DEBUG("handleDisplayFS()");
   String temp ="";
-  
-  openHtml("File System Manager");
-  if (server.args() > 0) // Parameter wurden ubergeben
+  String deleted;   // (deleted by processNetworkActions(), so it may still be there)
+
+  AsyncResponseStream *response = openHtml(request, "File System Manager");
+  if (request->args() > 0) // Parameter wurden ubergeben
     {
-      if (server.hasArg("delete"))
+      if (request->hasArg("delete"))
         {
-          String FToDel = server.arg("delete");
-          if (SPIFFS.exists(FToDel))
+          String FToDel = request->arg("delete");
+          if (ESP_FS.exists(FToDel) && orderFileChange(FILE_CHANGE_DELETE, FToDel.c_str()))
             {
-              SPIFFS.remove(FToDel);
+              deleted = FToDel;
               temp += "File " + FToDel + " successfully deleted.";
             } else
             {
               temp += "File " + FToDel + " cannot be deleted.";
             }
-          server.sendContent(temp);
+          response->print(temp);
           temp = "";
         }
-      if (server.hasArg("format") && server.arg("on"))
+      if (request->hasArg("format") && (request->arg("format") == "on"))
         {
-           SPIFFS.format();
-           temp += "SPI File System successfully formatted.";
-           server.sendContent(temp);
+           orderAction(ACTION_FORMAT_FS);  // takes far too long to be done within the handler
+           temp += "Formatting the SPI File System - this takes up to 30 seconds.";
+           response->print(temp);
            temp = "";
-        } //   server.client().stop(); // Stop is needed because we sent no content length
+        }
+      if (request->hasArg("reindex"))
+        {
+           orderAction(ACTION_RESCAN_IMAGES);  // has to check every file
+           response->print("Rebuilding the image index.");
+        }
     }
 
-  temp += "<table border=2 bgcolor = white width = 400 ><td><h4>Current SPIFFS Status: </h4>";
+  temp += "<table border=2 bgcolor = white width = 400 ><td><h4>Current " ESP_FS_NAME " Status: </h4>";
   { size_t usedBytes  = esp_get_fs_usedBytes() * 1.05,
            totalBytes = esp_get_fs_totalBytes();
   temp += formatBytes(usedBytes) + " of " + formatBytes(totalBytes) + " used. <br>";
   temp += formatBytes(totalBytes - usedBytes)+ " free. <br>";
   }
   temp += "</td></table><br>";
-  server.sendContent(temp);
+  response->print(temp);
   temp = "";
   // Check for Site Parameters
   temp += "<table border=2 bgcolor=white width=480><tr><th>";
-  temp += "<h4>Available Files on SPIFFS:</h4><table border=0 bgcolor=white></tr></th><td>Filename</td><td>Size</td><td>Action </td></tr></th>";
-  server.sendContent(temp);
+  temp += "<h4>Available Files on " ESP_FS_NAME ":</h4><table border=0 bgcolor=white></tr></th><td>Filename</td><td>Size</td><td>Action </td></tr></th>";
+  response->print(temp);
   temp = "";
   ESP_CLASS_DIR root = esp_openDir("/");
   File file;
   while (file = esp_openNextFile(root))
   {
-     temp += "<td> <a title=\"Download\" href =\"" + String(file.name()) + "\" download=\"" + String(file.name()) + "\">" + String(file.name()) + "</a> <br></th>";
+     if(esp_filePath(file) == deleted)  continue;
+     temp += "<td> <a title=\"Download\" href =\"" + esp_filePath(file) + "\" download=\"" + esp_filePath(file) + "\">" + esp_filePath(file) + "</a> <br></th>";
      temp += "<td>"+ formatBytes(file.size())+ "</td>";
-     temp += "<td><a href=filesystem?delete=" + String(urlencode(file.name())) + "> Delete </a></td>";
+     temp += "<td><a href=filesystem?delete=" + String(urlencode(esp_filePath(file).c_str())) + "> Delete </a>";
+     if(slideshow_is_playlist(esp_filePath(file).c_str()))
+       temp += " <a href=slideshow?on=1&playlist=" + String(urlencode(esp_filePath(file).c_str())) + "> Play </a>";
+     temp += "</td>";
      temp += "</tr></th>";
   }
   temp += "</tr></th>";
@@ -354,220 +989,171 @@ Serial.println("handleDisplayFS()");
   temp += "<label> Choose File: </label>";
   temp += "<form method='POST' action='/upload' enctype='multipart/form-data' style='height:35px;'><input type='file' name='upload' style='height:35px; font-size:13px;' required>\r\n<input type='submit' value='Upload' class='button'></form>";
   temp += " </table><br>";
-  server.sendContent(temp);
+  temp += "<table border=2 bgcolor=white width=400><td><h4>Upload an archive</h4>";
+  temp += "<label> Choose a .tar file - all files in it are stored: </label>";
+  temp += "<form method='POST' action='/upload_tar' enctype='multipart/form-data' style='height:35px;'><input type='file' name='upload' accept='.tar' style='height:35px; font-size:13px;' required>\r\n<input type='submit' value='Upload' class='button'></form>";
+  temp += " </table><br>";
+  response->print(temp);
+
+  temp  = "<table border=2 bgcolor=white width=400><td><h4>Image index</h4>";
+  temp += String(image_index_count()) + " images. Files copied to the " ESP_FS_NAME " by other means than uploading are found after ";
+  temp += "<a href=filesystem?reindex=on>rebuilding the index</a> (checks every file).</table><br>";
+  response->print(temp);
 
-  temp  = "<table border=2 bgcolor=white width=400><td><h4>Format SPIFFS Filesystem</h4>";
+#ifndef USE_SD
+  temp  = "<table border=2 bgcolor=white width=400><td><h4>Format " ESP_FS_NAME " Filesystem</h4>";
   temp += "<a href=filesystem?format=on>Go! (takes up to 30 seconds)</a></table><br>";
-  server.sendContent(temp);
+  response->print(temp);
+#endif
   
-  finishHTML(LINK_FILEMANAGER);
+  finishHTML(request, response, LINK_FILEMANAGER);
 }
 
 // a) check, if a file (exists and) is displayable
 // and b) if so, return its "basic" data: type, size, bit-depth
 // returns NULL, if the file is not displayable
+// (only the header is read - JpegDec can't be used here: it is not reentrant and may be rendering concurrently in loop())
 struct gfxFileInfo *scanFile(const char *filename)
 {
     static struct gfxFileInfo result;
-    
-    bool valid = false;
-    char *ext = strrchr(filename, '.');
-    if(!ext)    return NULL;    // no extension found => type undeterminable => invalid
-    ++ext;  // skip '.' itself (for the following comparisons)
-    
-    if(strcasecmp(ext, "bmp") == 0)
-    {
-        BMPHeader PicData = ReadBitmapSpecs(filename);
-        if (((PicData.width <= gfx_getScreenWidth()) && (PicData.height <= gfx_getScreenHeight())) &&
-          ((PicData.depth == 1) || (PicData.depth == 24)))                          // ... and when the bitmap has a known/understood bitdepth.
-        {
-            result.type   = GFI_TYPE_BMP;
-            result.width  = PicData.width;
-            result.height = PicData.height;
-            result.depth  = PicData.depth;
-            return &result;
-        }
-//else{
-//Serial.println(String(file.name())+": BMP "+String(PicData.width)+"*"+String(PicData.height)+"*"+String(PicData.depth));
-//if(PicData.width  > gfx_getScreenWidth())  Serial.println(String("\twidth > ")+String(gfx_getScreenWidth()));
-//if(PicData.height > gfx_getScreenHeight()) Serial.println(String("\theight > ")+String(gfx_getScreenHeight()));
-//if((PicData.depth != 1) && (PicData.depth != 24)) Serial.println("\tdepth neither 1 nor 24");
-//}
-    }
-    else if ((strcasecmp(ext, "jpg") == 0) || (strcasecmp(ext, "jpeg") == 0))
-    {
-        if(JpegDec.decodeFsFile(filename))
-            if(JpegDec.width <= gfx_getScreenWidth() && JpegDec.height <= gfx_getScreenHeight())
-            {
-                result.type   = GFI_TYPE_JPG;
-                result.width  = JpegDec.width;
-                result.height = JpegDec.height;
-                result.depth  = 24;
-                return &result;
-            }
-//else{
-//Serial.println(String(file.name())+": JPEG "+String(JpegDec.width)+"*"+String(JpegDec.height));
-//if(JpegDec.width  > gfx_getScreenWidth())  Serial.println(String("\twidth > ")+String(gfx_getScreenWidth()));
-//if(JpegDec.height > gfx_getScreenHeight()) Serial.println(String("\theight > ")+String(gfx_getScreenHeight()));
-//}
-    }
-////    else if (strcasecmp(ext, "gif") == 0)
-////    {
-////        if(???(filename))
-////            if(`?.width <= gfx_getScreenWidth() && ?.height <= gfx_getScreenHeight())
-////                {
-////                result.type   = GFI_TYPE_GIF;
-////                result.width  = ?.width;
-////                result.height = ?.height;
-////                result.depth  = 8;
-////                return &result;
-////            }
-////    }
-////    else if (strcasecmp(ext, "png") == 0)
-////    {
-////        if(???(filename))
-////            if(`?.width <= gfx_getScreenWidth() && ?.height <= gfx_getScreenHeight())
-////                {
-////                result.type   = GFI_TYPE_PNG;
-////                result.width  = ?.width;
-////                result.height = ?.height;
-////                result.depth  = ?;
-////                return &result;
-////            }
-////    }
 
+    if(sniffFile(filename, &result) && gfxFileDisplayable(&result))
+        return &result;
     return NULL;        // not recognized => invalid
 }
 
 // main page: list of images, option to display any of them
-void handleRoot(void)
+void handleRoot(AsyncWebServerRequest *request)
 {
  String temp = "";
- short PicCount = 0;
- byte ServArgs = 0;
+ uint32_t pos, first, count = image_index_count();
+ struct imageIndexRecord image;
 
-  openHtml(NULL);
+  AsyncResponseStream *response = openHtml(request, NULL);
 // Processing User Request
-if (server.args() > 0) // Parameter wurden ubergeben
+if (request->hasArg("PicSelect"))
 {
   temp += "<br>Processing input. Please wait..<br><br>";
-  server.sendContent(temp);
+  response->print(temp);
   temp = "";
-  if(server.hasArg("PicSelect"))
-  {
-    if (server.arg("PicSelect") == "off")  // Clear Display
+    if (request->arg("PicSelect") == "off")  // Clear Display
       {
-        gfx_clearScreen();
-        gfx_flushBuffer();
+        orderAction(ACTION_CLEAR);
       }
     else
       {
-        drawAnyImageType(server.arg("PicSelect").c_str()); // Bild gewählt. Display inhalt per Picselect hergstellt
+        orderDisplay(request->arg("PicSelect").c_str()); // Bild gewählt. Display inhalt per Picselect hergstellt
       }
-  }
 }
-  temp += "<table border=2 bgcolor = white ><caption><p><h3>Available Pictures in SPIFFS for "+String(gfx_getScreenWidth())+"*"+String(gfx_getScreenHeight())+" Display</h2></p></caption>";
+  // the images are listed in pages of LIST_PAGE_SIZE
+  first = request->arg("page").toInt() * LIST_PAGE_SIZE;
+  if(first >= count)  first = 0;
+  temp += "<table border=2 bgcolor = white ><caption><p><h3>Available Pictures in " ESP_FS_NAME " for "+String(gfx_getScreenWidth())+"*"+String(gfx_getScreenHeight())+" Display</h2></p></caption>";
   temp += "<form><tr><th><a href='?PicSelect=off&action=0'>Clear Display</a></th></tr>";
-  server.sendContent(temp);
-  //List available graphics files on SPIFFS
-  ESP_CLASS_DIR root = esp_openDir("/");
-  File file;
-  PicCount = 1;
-  while (file = esp_openNextFile(root))
+  temp += "<input type='hidden' name='page' value='" + String(first / LIST_PAGE_SIZE) + "'/>";
+  response->print(temp);
+  //List available graphics files from the index
+  for(pos = first; (pos < count) && (pos < first + LIST_PAGE_SIZE); pos++)
   {
-    struct gfxFileInfo *gfi = scanFile(file.name());
-    if(gfi)
+    if(!image_index_get(pos, &image))   break;
+    switch(image.type)
     {
-        bool valid = false;
-        switch(gfi->type)
-        {
-            case GFI_TYPE_BMP:
-                temp = String(gfi->width) + "*" + String(gfi->height) + "px*" + String(gfi->depth) + "bit";
-                valid = true;
-                break;
-            case GFI_TYPE_JPG:
-                temp = String(gfi->width) + "*" + String(gfi->height) + "px";
-                valid = true;
-                break;
-//            case GFI_TYPE_GIF:
-//                break;
-//            case GFI_TYPE_PNG:
-//                break;
-        }
-        if(valid)
-        {
-            temp = "<tr><th><label for='radio1'><img src='"+String(file.name())+"' alt='"+ String(file.name())+"' border='3' bordercolor=green> Image "+ PicCount+"</label><input type='radio' value='"+ String(file.name())+"' name='PicSelect'/><br> "+String(file.name())+": " + temp;
-            temp += "; filesize: "+ formatBytes(file.size()) + "</th></tr>";
-            server.sendContent(temp);
-            if(PicCount <= SLIDESHOW_MAX_IMAGES)
-            {
-                strncpy(slideshow_filenames[PicCount-1], file.name(), MAX_FILENAME_LEN+1);
-            }
-            PicCount++;
-        }
+        case GFI_TYPE_BMP:
+            temp = String(image.width) + "*" + String(image.height) + "px*" + String(image.depth) + "bit";
+            break;
+        default:
+            temp = String(image.width) + "*" + String(image.height) + "px";
+            break;
     }
+    temp = "<tr><th><label for='radio1'><img src='"+String(image.filename)+"' alt='"+ String(image.filename)+"' border='3' bordercolor=green> Image "+ (pos+1)+"</label><input type='radio' value='"+ String(image.filename)+"' name='PicSelect'/><br> "+String(image.filename)+": " + temp;
+    temp += "; filesize: "+ formatBytes(image.size) + "</th></tr>";
+    response->print(temp);
   }
-  slideshow_num_images = PicCount - 1;
   temp = "<tr><th><button type='submit' name='action' value='0' style='height: 50px; width: 280px'>Show Image on Display</button></th></tr>";
+  if(count > LIST_PAGE_SIZE)
+  {
+    temp += "<tr><th>";
+    if(first)   temp += "<a href='?page=" + String(first / LIST_PAGE_SIZE - 1) + "'>&lt; previous</a> ";
+    temp += String("images ") + (first+1) + "-" + pos + " of " + count;
+    if(pos < count) temp += " <a href='?page=" + String(first / LIST_PAGE_SIZE + 1) + "'>next &gt;</a>";
+    temp += "</th></tr>";
+  }
   temp += "</form></table>";
-  server.sendContent(temp);
+  response->print(temp);
 
-  finishHTML(LINK_MAIN);
+  finishHTML(request, response, LINK_MAIN);
 }
 
-// create/update the "index" of images that may be displayed - to be used in the slideshow
-// in fact, this is a stripped down version of handleRoot()
-// updates the global vars slideshow_filenames[] and slideshow_num_images
+// (re)build the index of images that may be displayed (see imageindex.h) - to be used by the listing and the slideshow.
+// walks the whole directory and checks every file; uploads and deletions update the index without this
 void scan_images_for_slideshow(void)
 {
     File file;
     ESP_CLASS_DIR root = esp_openDir("/");
 
-    slideshow_num_images = 0;
-    while((bool)(file = esp_openNextFile(root)) && (slideshow_num_images < SLIDESHOW_MAX_IMAGES))
+    image_index_clear();
+    while((bool)(file = esp_openNextFile(root)))
     {
-        //bool valid;
-        struct gfxFileInfo *gfi = scanFile(file.name());
-        //valid = gfi ? (gfi->type != GFI_TYPE_INVALID) : false;
-        //if(valid && (slideshow_num_images < SLIDESHOW_MAX_IMAGES))
-        if(gfi && (gfi->type != GFI_TYPE_INVALID))
-        {
-            strncpy(slideshow_filenames[slideshow_num_images++], file.name(), MAX_FILENAME_LEN+1);
-        }
+        String filename = esp_filePath(file);
+        struct gfxFileInfo *gfi = scanFile(filename.c_str());
+
+        if(gfi)     image_index_append(filename.c_str(), gfi, file.size());
     }
-    if(slideshow_num_images < 1)    slideshow_is_running = false;
 }
 
-void handleNotFound(void)
+// the timing of all drawing and of the handlers, for monitoring (Prometheus format)
+void handleMetrics(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+    metrics_print(*response);
+    request->send(response);
+}
+
+// the recent diagnostic messages (see log.h)
+void handleLog(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("text/plain");
+    log_print(*response);
+    request->send(response);
+}
+
+// the heap now and what the handlers and drawing did to it
+void handleHeap(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("text/plain");
+    metrics_heap_print(*response);
+    request->send(response);
+}
+
+void handleNotFound(AsyncWebServerRequest *request)
 {   uint8_t i;
-//Serial.print("handleNotFound() starting, server.uri() ~ ");
-//Serial.println(server.uri());
+//Serial.print("handleNotFound() starting, request->url() ~ ");
+//Serial.println(request->url());
 
     // If captive portal redirect instead of displaying the error page.
-    if(captivePortal()) return;
+    if(captivePortal(request)) return;
 //Serial.println("handleNotFound() after captivePortal()");
   
     // if there is an according file: fine
-    if (handleFileRead(server.urlDecode(server.uri()))) return;
+    if (handleFileRead(request, request->url())) return;   // url() is already decoded
 //Serial.println("handleNotFound() no file found");
 
     // else: send error page:
     String temp = "";
-    httpHeaders();
     // HTML Content
     temp += "<!DOCTYPE HTML><html lang='de'><head><meta charset='UTF-8'><meta name= viewport content='width=device-width, initial-scale=1.0,'>";
     temp += css_definition;
     temp += "<title>" PROJECT_TITLE " - File not found</title></head>";
     temp += "<body><h2>404 File Not Found</h2>";
     temp += "<h4>Debug Information:</h4>";
-    temp += "<pre>URI: "+server.uri();
+    temp += "<pre>URI: "+request->url();
     temp += "\nMethod: ";
-    temp += ( server.method() == HTTP_GET ) ? "GET" : "POST";
-    temp += String("\n\nArguments: ")+server.args()+"\n";
-    for(i=0; i<server.args();    i++) temp += " " + server.argName(i)    + ": " + server.arg(i)    + "\n";
-    temp += "\nServer HostHeader: "+ server.hostHeader();
+    temp += request->methodToString();
+    temp += String("\n\nArguments: ")+request->args()+"\n";
+    for(i=0; i<request->args();    i++) temp += " " + request->argName(i)    + ": " + request->arg(i)    + "\n";
+    temp += "\nServer HostHeader: "+ request->host();
     temp += "\n";
-    for(i=0; i<server.headers(); i++) temp += " " + server.headerName(i) + ": " + server.header(i) + "\n";
+    for(i=0; i<request->headers(); i++) temp += " " + request->headerName(i) + ": " + request->header(i) + "\n";
     temp += "</pre><br><table border=2 bgcolor=white width=500 cellpadding=5><caption><p><h2>You may want to browse to:</h2></p></caption>";
     temp += "<tr><th>";
     temp += "<a href='/'>Main Page</a><br>";
@@ -576,74 +1162,88 @@ void handleNotFound(void)
     temp += "</th></tr></table><br><br>";
     temp += html_footer;
     temp += "</body></html>";
-    server.send ( 404, "text/html", temp );
-    server.client().stop(); // Stop is needed because we sent no content length
+    AsyncWebServerResponse *response = request->beginResponse(404, "text/html", temp);
+    httpHeaders(response);
+    request->send(response);
 }
 
 // Redirect to captive portal if we got a request for another domain. Return true in that case so the page handler do not try to handle the request again.
-boolean captivePortal(void)
+boolean captivePortal(AsyncWebServerRequest *request)
 {
-  if (!isIp(server.hostHeader()) && server.hostHeader() != (String(ESPHostname)+".local")) {
+  if (!isIp(request->host()) && request->host() != (String(ESPHostname)+".local")) {
     // Serial.println("Request redirected to captive portal");
-    server.sendHeader("Location", String("http://") + toStringIp(server.client().localIP()), true);
-    server.send ( 302, "text/plain", ""); // Empty content inhibits Content-length header so we have to close the socket ourselves.
-    server.client().stop(); // Stop is needed because we sent no content length
+    AsyncWebServerResponse *response = request->beginResponse(302, "text/plain", "");
+    response->addHeader("Location", String("http://") + toStringIp(request->client()->localIP()));
+    request->send(response);
     return true;
   }
   return false;
 }
 
 // settings page handler
-void handleSettings(void)
+void handleSettings(AsyncWebServerRequest *request)
 {
   //  page: /settings
   byte i, j, len;
   String temp = "";
+  // the handler changes a copy of the settings, taken over by processNetworkActions() - so loop() never sees them
+  // half changed. Within this function, the copy shadows the global MySettings (that the SETTINGS_ macros use)
+  struct EEPromData settings;
+  struct EEPromData &MySettings = settings;
+  copySettings(&settings);
   // check for site parameters
 
     // parameter save does not exist, if the page is just called, only when the form here was submitted
     // that check is necessary because there is no difference between an unchecked checkbox and a non-existing checkbox.
     // so, without the condition, all checkboxes would be like unchecked just before - when just entering this page.
-    if(server.hasArg("save"))
+    if(request->hasArg("save"))
     {
         // start slideshow automatically ?
-        SETTINGS_PUT_SLIDESHOW_AUTORUN(server.hasArg("autorun_slideshow"));
+        SETTINGS_PUT_SLIDESHOW_AUTORUN(request->hasArg("autorun_slideshow"));
         // show IP address on startup ?
-        SETTINGS_PUT_SHOW_IP(server.hasArg("show_ip"));
+        SETTINGS_PUT_SHOW_IP(request->hasArg("show_ip"));
         // show WiFi name (SSID) on startup ?
-        SETTINGS_PUT_SHOW_SSID(server.hasArg("show_ssid"));
+        SETTINGS_PUT_SHOW_SSID(request->hasArg("show_ssid"));
         // show WiFi (AP) password on startup ?
-        SETTINGS_PUT_WIFI_PWD_EXHIBITION(server.hasArg("exhibit_passwd"));
+        SETTINGS_PUT_WIFI_PWD_EXHIBITION(request->hasArg("exhibit_passwd"));
+        // synchronized slideshows: leader, follower or neither?
+        SETTINGS_PUT_SYNC_LEADER(request->arg("sync") == "leader");
+        SETTINGS_PUT_SYNC_FOLLOWER(request->arg("sync") == "follower");
+        // video wall: the part of the image shown here (render_set_wall() checks, too)
+        uint8_t wall_cols = MySettings.wall_cols, wall_rows = MySettings.wall_rows;
+        MySettings.wall_cols = constrain(request->arg("wall_cols").toInt(), 1, 255);
+        MySettings.wall_rows = constrain(request->arg("wall_rows").toInt(), 1, 255);
+        MySettings.wall_col  = constrain(request->arg("wall_col").toInt() - 1, 0, MySettings.wall_cols - 1);
+        MySettings.wall_row  = constrain(request->arg("wall_row").toInt() - 1, 0, MySettings.wall_rows - 1);
+        // another size of the wall: other images fit it
+        orderSettings(&settings, ((MySettings.wall_cols != wall_cols) || (MySettings.wall_rows != wall_rows)) ? ACTION_RESCAN_IMAGES : 0);
     }
 
-    if (server.hasArg("Reboot") )  // reboot system
+    if (request->hasArg("Reboot") )  // reboot system
        {
          temp = "Rebooting System in 5 Seconds..";
-         server.send ( 200, "text/html", temp );
-         delay(5000);
-         server.client().stop();
-         WiFi.disconnect();
-         delay(1000);
-         ESP.restart();
+         request->send ( 200, "text/html", temp );
+         orderAction(ACTION_REBOOT);
+         return;
        }
 
-    if (server.hasArg("WiFiMode") && (server.arg("WiFiMode") == "1")  )  // STA station mode connect to another WIFI station
+    if (request->hasArg("WiFiMode") && (request->arg("WiFiMode") == "1")  )  // STA station mode connect to another WIFI station
        {
         // connect to existing STATION
-        if ( sizeof(server.arg("WiFi_Network")) > 0  )
+        if ( sizeof(request->arg("WiFi_Network")) > 0  )
           {
-            Serial.println("STA mode");
+            LOG_INFO("STA mode");
             SETTINGS_SET_STA_MODE;
             temp = "";
             for(i = 0; i < APSTANameLen; i++) MySettings.WiFiAPSTAName[i] = 0;
-            temp = server.arg("WiFi_Network");
+            temp = request->arg("WiFi_Network");
             len = temp.length();
             for(i = 0; i < len; i++) MySettings.WiFiAPSTAName[i] = temp[i];
             MySettings.WiFiAPSTAName[len+1] = 0;
             temp = "";
 
             for(i = 0; i < WiFiPwdLen; i++)  MySettings.WiFiPwd[i] = 0;
-            temp = server.arg("STAWLanPW");
+            temp = request->arg("STAWLanPW");
             len = temp.length();
             if(len > 0) // don't clear a previous password!
             {
@@ -662,82 +1262,50 @@ void handleSettings(void)
             // temp += MySettings.WiFiPwd;
             temp += "'<br>";
             temp += "connecting to STA mode in 2 seconds..<br>";
-            server.send ( 200, "text/html", temp );
-            server.sendContent(temp);
-            delay(2000);
-            server.client().stop();
-            server.stop();
-            temp = "";
-            WiFi.disconnect();
-            WiFi.softAPdisconnect(true);
-            delay(500);
-            // ConnectWifiAP
-            bool SaveOk = saveSettings();
-            i = ConnectWifiAP();
-            delay(700);
-            if (i != 3) // 4: WL_CONNECT_FAILED - Password is incorrect 1: WL_NO_SSID_AVAILin - configured SSID cannot be reached
-              {
-                 Serial.print(F("cannot connect to specified network. reason: "));
-                 Serial.println(i);
-                 server.client().stop();
-                 delay(100);
-                 WiFi.setAutoReconnect (false);
-                 delay(100);
-                 WiFi.disconnect();
-                 delay(1000);
-                 SetDefaultWiFiSettings();
-                 CreateWifiSoftAP();
-                 return;
-              } else
-              {
-                 // connection succeeded - save settings
-                 bool SaveOk = saveSettings();
-                 InitializeHTTPServer();
-                 return;
-              }
+            request->send ( 200, "text/html", temp );
+            orderSettings(&settings, ACTION_CONNECT_STA);
+            return;
           }
        }
 
-      if (server.hasArg("WiFiMode") && (server.arg("WiFiMode") == "2")  )  // change AP mode
+      if (request->hasArg("WiFiMode") && (request->arg("WiFiMode") == "2")  )  // change AP mode
        {
         // configure access point
-        temp = server.arg("APPointName");
+        temp = request->arg("APPointName");
         len =  temp.length();
-        temp = server.arg("APPW");
-        i = server.hasArg("PasswordReq") ? temp.length() : 8;
+        temp = request->arg("APPW");
+        i = request->hasArg("PasswordReq") ? temp.length() : 8;
 
-        if (  ( len > 1 ) && (server.arg("APPW") == server.arg("APPWRepeat")) && ( i > 7) )
+        if (  ( len > 1 ) && (request->arg("APPW") == request->arg("APPWRepeat")) && ( i > 7) )
         {
             temp = "";
-            Serial.println(F("APMode"));
+            LOG_INFO("APMode");
             SETTINGS_SET_AP_MODE;
-            SETTINGS_SET_PORTAL_CAPTIVITY(server.hasArg("CaptivePortal"));
-            SETTINGS_PUT_WIFI_PWD_EXHIBITION(!server.hasArg("PasswordReq"));
+            SETTINGS_SET_PORTAL_CAPTIVITY(request->hasArg("CaptivePortal"));
+            SETTINGS_PUT_WIFI_PWD_EXHIBITION(!request->hasArg("PasswordReq"));
 
             for (i = 0; i < APSTANameLen; i++)  MySettings.WiFiAPSTAName[i] = 0;
-            temp = server.arg("APPointName");
+            temp = request->arg("APPointName");
             len = temp.length();
             for (i = 0; i < len; i++) MySettings.WiFiAPSTAName[i] = temp[i];
             MySettings.WiFiAPSTAName[len+1] = 0;
             temp = "";
             for (i = 0; i < WiFiPwdLen; i++)    MySettings.WiFiPwd[i] = 0;
-            temp = server.arg("APPW");
+            temp = request->arg("APPW");
             len = temp.length();
             for (i = 0; i < len; i++)   MySettings.WiFiPwd[i] = temp[i];
             MySettings.WiFiPwd[len+1] = 0;
-            temp = "";
-            temp = saveSettings() ? // save AP settings
-                    "Settings saved successfully. Reboot required." :
-                    "corrupted settings not saved.";
-        } else temp = (server.arg("APPW") != server.arg("APPWRepeat")) ?
+            temp = "Settings saved. Reboot required.";    // (if that fails, it is logged)
+            orderSettings(&settings, ACTION_SAVE_SETTINGS);
+        } else temp = (request->arg("APPW") != request->arg("APPWRepeat")) ?
                   "WiFi password(s) differ. Aborted." :
                   "WiFi password too short. Aborted.";
        // End Wifi
        }
 
-  openHtml("Settings");
+  AsyncResponseStream *response = openHtml(request, "Settings");
   temp += "<table border=2 bgcolor=white width=500><td><h4>Current WiFi Settings:</h4>";
-  if (server.client().localIP() == apIP) {
+  if (request->client()->localIP() == apIP) {
      temp += "Mode : Soft Access Point (AP)<br>";
      temp += "SSID : " + String (MySettings.WiFiAPSTAName) + "<br><br>";
   } else {
@@ -746,17 +1314,19 @@ void handleSettings(void)
      temp += "BSSID :  " + WiFi.BSSIDstr()+ "<br><br>";
   }
   temp += "</td></table><br>";
-  server.sendContent(temp);
+  response->print(temp);
   temp = "";
   temp += "<form action='/settings' method='post'><input type='hidden' name='save' value=1>";
   temp += "<table border=2 bgcolor = white width = 500><tr><th><br>";
   temp += SETTINGS_IS_AP_MODE ? "<input type='radio' value='1' name='WiFiMode' > WiFi Station Mode<br>" :
                                 "<input type='radio' value='1' name='WiFiMode' checked > WiFi Station Mode<br>";
   temp += "Available WiFi Networks:<table border=2 bgcolor = white ></tr></th><td>Number </td><td>SSID  </td><td>Encryption </td><td>WiFi Strength </td>";
-  server.sendContent(temp);
+  response->print(temp);
   temp = "";
-  WiFi.scanDelete();
-  int n = WiFi.scanNetworks(false, false); //WiFi.scanNetworks(async, show_hidden)
+  // a synchronous scan would block the webserver for seconds - so the results of the previous
+  // (asynchronous) scan are listed and a new one is started for the next time this page is requested
+  int n = WiFi.scanComplete();
+  if (n == WIFI_SCAN_FAILED) WiFi.scanNetworks(true, false); //WiFi.scanNetworks(async, show_hidden)
   if (n > 0)
   {
     for (int i = 0; i < n; i++)
@@ -773,7 +1343,7 @@ void handleSettings(void)
   } else {
     temp += "</tr></th>";
     temp += "<td>1 </td>";
-    temp += "<td>No WiFi found</td>";
+    temp += (n < 0) ? "<td>scanning... (reload the page)</td>" : "<td>No WiFi found</td>";
     temp += "<td> --- </td>";
     temp += "<td> --- </td>";
   }
@@ -788,19 +1358,24 @@ void handleSettings(void)
   } else {
     temp += "<option value='No_WiFi_Network'>No WiFi network found !</option>";
   }
-  server.sendContent(temp);
+  if (n >= 0)
+  {   // refresh the list for the next call
+      WiFi.scanDelete();
+      WiFi.scanNetworks(true, false);
+  }
+  response->print(temp);
   temp = "";
   temp += "</select></td></tr></th><tr><td>WiFi Password: </td><td>";
   temp += "<input type='password' name='STAWLanPW' maxlength='40' size='40'>";
   temp += "</td></tr></th><br></th></tr></table></table><table border=2 bgcolor=white width=500><tr><th><br>";
-  server.sendContent(temp);
+  response->print(temp);
   temp  = SETTINGS_IS_AP_MODE ? "<input type='radio' name='WiFiMode' value='2' checked> WiFi Access Point Mode<br>" :
                                 "<input type='radio' name='WiFiMode' value='2' > WiFi Access Point Mode<br>";
   temp += "<table border=2 bgcolor = white ></tr></th> <td>WiFi Access Point Name: </td><td>";
-  server.sendContent(temp);
+  response->print(temp);
   temp = SETTINGS_IS_AP_MODE ? "<input type='text' name='APPointName' maxlength='"+String(APSTANameLen-1)+"' size='30' value='" + String(MySettings.WiFiAPSTAName) + "'></td>" :
                                "<input type='text' name='APPointName' maxlength='"+String(APSTANameLen-1)+"' size='30' ></td>";
-  server.sendContent(temp);
+  response->print(temp);
   temp = "";
   temp += "</tr></th><td>WiFi Password: </td><td>";
   if (SETTINGS_IS_AP_MODE)
@@ -815,14 +1390,14 @@ void handleSettings(void)
       temp += "<td><input type='password' name='APPWRepeat' maxlength='"+String(WiFiPwdLen-1)+"' size='30'> </td>";
     }
   temp += "</table>";
-  server.sendContent(temp);
+  response->print(temp);
   temp = SETTINGS_IS_WIFI_PASSWORD_REQUIRED ? "<input type='checkbox' name='PasswordReq' checked> Password for Login required." :
                                               "<input type='checkbox' name='PasswordReq' > Password for Login required.";
-  server.sendContent(temp);
+  response->print(temp);
   temp = SETTINGS_IS_CAPTIVE_PORTAL ? "<input type='checkbox' name='CaptivePortal' checked> Activate Captive Portal" :
                                       "<input type='checkbox' name='CaptivePortal' > Activate Captive Portal";
   temp += "<br></tr></th></table>";
-  server.sendContent(temp);
+  response->print(temp);
 
   temp  = "<table border=2 bgcolor=white width=500 cellpadding=5><caption><h3>misc settings:</h3></caption><tr><th align=left><br>";
   temp += "<input type='checkbox' name='autorun_slideshow'";
@@ -841,34 +1416,49 @@ void handleSettings(void)
   if(SETTINGS_IS_WIFI_PWD_EXHIBITED)
       temp += " checked";
   temp += "> show WiFi (AP) password on startup - <font color=red>unsafe!</font><br>";
+  temp += "<br>slideshow synchronized with other displays:<br>";
+  temp += "<input type='radio' name='sync' value='none'";
+  if(!SETTINGS_IS_SYNC_LEADER && !SETTINGS_IS_SYNC_FOLLOWER)
+      temp += " checked";
+  temp += "> no<br>";
+  temp += "<input type='radio' name='sync' value='leader'";
+  if(SETTINGS_IS_SYNC_LEADER)
+      temp += " checked";
+  temp += "> yes, as leader (the others show what this one does)<br>";
+  temp += "<input type='radio' name='sync' value='follower'";
+  if(SETTINGS_IS_SYNC_FOLLOWER)
+      temp += " checked";
+  temp += "> yes, as follower (needs the same files as the leader)<br>";
+  temp += "<br>video wall (the images are spread over several displays): ";
+  temp += "<input type='number' name='wall_cols' min=1 max=255 style='width: 4em' value='" + String(MySettings.wall_cols) + "'> * ";
+  temp += "<input type='number' name='wall_rows' min=1 max=255 style='width: 4em' value='" + String(MySettings.wall_rows) + "'> displays,<br>";
+  temp += "this one is column <input type='number' name='wall_col' min=1 max=255 style='width: 4em' value='" + String(MySettings.wall_col+1) + "'> ";
+  temp += "of row <input type='number' name='wall_row' min=1 max=255 style='width: 4em' value='" + String(MySettings.wall_row+1) + "'><br>";
   temp += "<br></th></tr></table>";
-  server.sendContent(temp);
+  response->print(temp);
 
   temp = "";
   temp += "<br> <button type='submit' name='Settings' value='1' style='height: 50px; width: 140px' autofocus>Save Settings</button>";
   temp += "<button type='submit' name='Reboot' value='1' style='height: 50px; width: 200px' >Reboot System</button>";
   temp += "<button type='reset' name='action' value='1' style='height: 50px; width: 100px' >Reset</button></form>";
-  server.sendContent(temp);
+  response->print(temp);
 
-    finishHTML(LINK_SETTINGS);
+    finishHTML(request, response, LINK_SETTINGS);
 }
 
-void handleSlideshow(void)
+void handleSlideshow(AsyncWebServerRequest *request)
 {
-    if(server.hasArg("on"))
+    if(request->hasArg("on"))
     {
-        Serial.println("Slideshow on");
-        slideshow_is_running = true;
-        slideshow_last_switch = slideshow_current_index = 0;
-    } else if(server.hasArg("off"))
+        slideshow_start(request->hasArg("playlist") ? request->arg("playlist").c_str() : NULL);
+    } else if(request->hasArg("off"))
     {
-        Serial.println("Slideshow off");
-        slideshow_is_running = false;
+        slideshow_stop();
     }
-    else Serial.println("Slideshow ???");
+    else LOG_WARN("Slideshow ???");
 
     // "redirect" to main page, "/"
-    redirectMain();
+    redirectMain(request);
 }
 
 void doShowWifi(bool force)
@@ -880,17 +1470,16 @@ void doShowWifi(bool force)
     if((uint32_t)myIP == 0)
     {
         myIP = WiFi.softAPIP();
-        Serial.print("WiFi.softAPIP() = ");
+        LOG_INFO("WiFi.softAPIP() = %s", myIP.toString().c_str());
     }
     else
-        Serial.print("WiFi.localIP() = ");
-    Serial.println(myIP);
+        LOG_INFO("WiFi.localIP() = %s", myIP.toString().c_str());
     // gfx_setTextColor(1); // never changed after setup(), so not necessary
     if(force || SETTINGS_IS_IP_SHOWN)   gfx_drawString(10,12, myIP.toString().c_str());
     }
 
     // SSID
-    Serial.println("WiFi.SSID = " + WiFi.SSID());
+    LOG_INFO("WiFi.SSID = %s", WiFi.SSID().c_str());
     if(force || SETTINGS_IS_SSID_SHOWN) gfx_drawString(10,32, WiFi.SSID().c_str());
 
     // AP password
@@ -898,13 +1487,13 @@ void doShowWifi(bool force)
     {
         if(SETTINGS_IS_WIFI_PASSWORD_REQUIRED)
         {
-            Serial.print("WiFi(AP) password = ");
+            Serial.print("WiFi(AP) password = ");     // not to the log: that can be read by HTTP
             Serial.println(MySettings.WiFiPwd);
             if(SETTINGS_IS_WIFI_PWD_EXHIBITED)  gfx_drawString(10,52, MySettings.WiFiPwd);
         }
         else
         {
-            Serial.println("'open' WiFi AP: unencrypted, unsafe, no password required");
+            LOG_WARN("'open' WiFi AP: unencrypted, unsafe, no password required");
             if(SETTINGS_IS_WIFI_PWD_EXHIBITED)  gfx_drawString(10,52, "no pw required");
         }
     }
@@ -912,14 +1501,101 @@ void doShowWifi(bool force)
     gfx_flushBuffer();
 }
 
-void handleShowWifi(void)
+void handleShowWifi(AsyncWebServerRequest *request)
 {
-    doShowWifi(true);
-    // "suspend" the slideshow for one cycle (no need to check if it is running)
-    slideshow_last_switch = millis();
+    orderAction(ACTION_SHOW_WIFI);
 
     // "redirect" to main page, "/"
-    redirectMain();
+    redirectMain(request);
+}
+
+// connect to the WiFi network configured in MySettings (STA mode) - fall back to AP mode if that fails
+static void doConnectSTA(void)
+{
+    byte i;
+
+    delay(2000);    // give the response some time to reach the client
+    WiFi.disconnect();
+    WiFi.softAPdisconnect(true);
+    delay(500);
+    // ConnectWifiAP
+    if(!saveSettings()) LOG_ERROR("corrupted settings not saved.");
+    i = ConnectWifiAP();
+    delay(700);
+    if (i != 3) // 4: WL_CONNECT_FAILED - Password is incorrect 1: WL_NO_SSID_AVAILin - configured SSID cannot be reached
+      {
+         LOG_WARN("cannot connect to specified network. reason: %u", i);
+         delay(100);
+         WiFi.setAutoReconnect (false);
+         delay(100);
+         WiFi.disconnect();
+         delay(1000);
+         SetDefaultWiFiSettings();
+         CreateWifiSoftAP();
+      } else
+      {
+         // connection succeeded - save settings
+         if(!saveSettings())    LOG_ERROR("corrupted settings not saved.");
+      }
+}
+
+// do what the (asynchronous) HTTP handlers ordered - to be called from loop()
+void processNetworkActions(void)
+{
+    uint16_t actions;
+    char filename[MAX_FILENAME_LEN+1];
+
+    if(!pending_actions)    return;
+    esp_enter_critical();
+    actions = pending_actions;
+    pending_actions = 0;
+    strcpy(filename, pending_display_filename);
+    if(actions & ACTION_SETTINGS)   MySettings = pending_settings;
+    esp_exit_critical();
+
+    if(actions & ACTION_SETTINGS)
+    {
+        render_set_wall(MySettings.wall_cols, MySettings.wall_rows, MySettings.wall_col, MySettings.wall_row);
+        if((actions & ACTION_SAVE_SETTINGS) && !saveSettings()) LOG_ERROR("corrupted settings not saved.");
+    }
+    if(actions & ACTION_FILE_CHANGES)   processFileChanges();
+
+    if(actions & (ACTION_CLEAR | ACTION_DISPLAY | ACTION_SHOW_WIFI))
+    {
+        stream_invalidate();        // (the display shows something else)
+        slideshow_drawn_over();     // (a slide drawn ahead is gone from the buffer)
+    }
+    if(actions & ACTION_CLEAR)
+    {
+        gfx_clearScreen();
+        gfx_flushBuffer();
+    }
+    if(actions & ACTION_DISPLAY)    drawAnyImageType(filename);
+    if(actions & ACTION_SHOW_WIFI)
+    {
+        doShowWifi(true);
+        slideshow_suspend();    // (no need to check if it is running)
+    }
+    if(actions & ACTION_FORMAT_FS)
+    {
+        esp_fs_format();
+        image_cache_changed();
+        LOG_INFO(ESP_FS_NAME " formatted.");
+        scan_images_for_slideshow();
+    }
+    if(actions & ACTION_RESCAN_IMAGES)
+    {
+        scan_images_for_slideshow();
+        image_cache_changed();  // (the files may have changed by other means)
+    }
+    if(actions & ACTION_CONNECT_STA)    doConnectSTA();
+    if(actions & ACTION_REBOOT)
+    {
+        delay(5000);
+        WiFi.disconnect();
+        delay(1000);
+        ESP.restart();
+    }
 }
 
 // Is this an IP?
@@ -992,7 +1668,54 @@ String getContentType(String filename)      // convert the file extension to the
     return "text/plain";
 }
 
-bool handleFileRead(String path)    // send the right file to the client (if it exists)
+// the response to a request with a "Range: bytes=..." header: 206 with that part of the file, 416 if it is outside the file.
+// only a single range is supported (multiple ones would need a multipart response); if there are several, the first is used.
+static AsyncWebServerResponse *rangeResponse(AsyncWebServerRequest *request, const String &path, const String &contentType)
+{
+    File file = ESP_FS.open(path, "r");
+    size_t size = file.size();
+    String range = request->getHeader("Range")->value();
+    size_t first, last;
+    int dash = range.indexOf('-');
+    AsyncWebServerResponse *response;
+
+    if(!range.startsWith("bytes=") || (dash < 0))  // not understood => whole file
+    {
+        file.close();
+        return request->beginResponse(ESP_FS, path, contentType);
+    }
+    if(dash == 6)
+    {   // "bytes=-n": the last n bytes
+        size_t n = range.substring(7).toInt();
+        first = (n < size) ? size - n : 0;
+        last  = size - 1;
+    }
+    else
+    {   // "bytes=a-" or "bytes=a-b"
+        String end = range.substring(dash+1);
+        first = range.substring(6, dash).toInt();
+        last  = (end.length() && isDigit(end[0])) ? end.toInt() : size - 1;
+        if(last >= size)    last = size - 1;
+    }
+    if(!size || (first > last))
+    {
+        file.close();
+        response = request->beginResponse(416);
+        response->addHeader("Content-Range", String("bytes */") + size);
+        return response;
+    }
+    file.seek(first, SeekSet);
+    response = request->beginResponse(contentType, last - first + 1, [file, first](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+        // the filler is called with the offset within the range; file is kept open by the lambda (closed when the response is deleted)
+        if(file.position() != first + index)  file.seek(first + index, SeekSet);
+        return file.read(buffer, maxLen);
+    });
+    response->setCode(206);
+    response->addHeader("Content-Range", String("bytes ") + first + "-" + last + "/" + size);
+    return response;
+}
+
+bool handleFileRead(AsyncWebServerRequest *request, String path)    // send the right file to the client (if it exists)
 {
 //Serial.println(String("handleFileRead(")+path+")");
   if (path.endsWith("/")) path += "index.html";          // If a folder is requested, send the index file
@@ -1000,12 +1723,18 @@ bool handleFileRead(String path)    // send the right file to the client (if it
   String contentType = getContentType(path);             // Get the MIME type
 //Serial.println(String("handleFileRead(")+path+") #3");
   String pathWithGz = path + ".gz";
-  if (SPIFFS.exists(pathWithGz) || SPIFFS.exists(path)) { // If the file exists, either as a compressed archive, or normal
-    if (SPIFFS.exists(pathWithGz))                         // If there's a compressed version available
-      path += ".gz";                                       // Use the compressed version
-    File file = SPIFFS.open(path, "r");                    // Open the file
-    server.streamFile(file, contentType);                  // Send it to the client
-    file.close();                                          // Close the file again
+  if (ESP_FS.exists(path)) {
+    AsyncWebServerResponse *response;
+    if (request->hasHeader("Range"))
+      response = rangeResponse(request, path, contentType);
+    else
+      response = request->beginResponse(ESP_FS, path, contentType);    // streamed piecewise as the connection accepts data
+    // (no "Accept-Ranges: bytes": ESPAsyncWebServer adds "Accept-Ranges: none" to every response itself - ranges asked for are served anyway)
+    request->send(response);
+    return true;
+  }
+  if (ESP_FS.exists(pathWithGz)) {                        // the compressed version: no ranges, they would refer to the compressed data
+    request->send(ESP_FS, path, contentType);              // uses the .gz version as the file itself is missing
     return true;
   }
   return false;
@@ -1014,21 +1743,32 @@ bool handleFileRead(String path)    // send the right file to the client (if it
 void InitializeHTTPServer(void)
  {
   bool initok = false;
+  // CAUTION: call this only once - the asynchronous server keeps running independent of WiFi (re)configurations
   /* Setup web pages: root, wifi settings pages, SO captive portal detectors and not found. */
-  server.on("/", handleRoot);
-  server.on("/settings", handleSettings);
-  server.on("/filesystem", HTTP_GET, handleDisplayFS);
-  server.on("/slideshow", HTTP_GET, handleSlideshow);
-  server.on("/showwifi", HTTP_GET, handleShowWifi);
+  // METERED(): the time each handler takes and its effect on the heap are recorded (see metrics.h); the upload data handlers are not metered
+#define METERED(handler, function)  [](AsyncWebServerRequest *request) { metricHeap heap = metrics_heap(); unsigned long start = micros(); \
+                                                                     function(request); metrics_http(handler, micros()-start, heap); }
+  server.on("/", METERED(HANDLER_ROOT, handleRoot));
+  server.on("/settings", METERED(HANDLER_SETTINGS, handleSettings));
+  server.on("/filesystem", HTTP_GET, METERED(HANDLER_FILESYSTEM, handleDisplayFS));
+  server.on("/slideshow", HTTP_GET, METERED(HANDLER_SLIDESHOW, handleSlideshow));
+  server.on("/showwifi", HTTP_GET, METERED(HANDLER_SHOWWIFI, handleShowWifi));
+  server.on("/metrics", HTTP_GET, METERED(HANDLER_METRICS, handleMetrics));
+  server.on("/heap", HTTP_GET, METERED(HANDLER_METRICS, handleHeap));
+  server.on("/log", HTTP_GET, METERED(HANDLER_METRICS, handleLog));
   // server.on("/upload", HTTP_POST, handleFileUpload);    Upload will not work!!!
-  server.on("/upload", HTTP_POST, []() { server.send(200, "text/plain", ""); }, handleFileUpload);
+  server.on("/upload", HTTP_POST, METERED(HANDLER_UPLOAD, handleUploadDone), handleFileUpload);
+  server.on("/upload_tar", HTTP_POST, METERED(HANDLER_UPLOAD_TAR, handleTarDone), handleTarUpload, handleTarBody);
+  server.on("/upload_chunk", HTTP_GET | HTTP_POST, METERED(HANDLER_UPLOAD_CHUNK, handleChunkDone), NULL, handleChunkBody);
   if(SETTINGS_IS_CAPTIVE_PORTAL)
   {
-    server.on("/generate_204", handleRoot);     //Android captive portal. Maybe not needed. Might be handled by notFound handler.
-    server.on("/favicon.ico", handleRoot);      //Another Android captive portal. Maybe not needed. Might be handled by notFound handler. Checked on Sony Handy
-    server.on("/fwlink", handleRoot);           //Microsoft captive portal. Maybe not needed. Might be handled by notFound handler.
+    server.on("/generate_204", METERED(HANDLER_ROOT, handleRoot));  //Android captive portal. Maybe not needed. Might be handled by notFound handler.
+    server.on("/favicon.ico", METERED(HANDLER_ROOT, handleRoot));   //Another Android captive portal. Maybe not needed. Might be handled by notFound handler. Checked on Sony Handy
+    server.on("/fwlink", METERED(HANDLER_ROOT, handleRoot));        //Microsoft captive portal. Maybe not needed. Might be handled by notFound handler.
   }
-  server.onNotFound ( handleNotFound );
+  server.onNotFound (METERED(HANDLER_OTHER, handleNotFound));
+  stream_begin(server);     // the WebSocket /stream (and UDP)
+#undef METERED
   server.begin(); // Web server start
  }
 
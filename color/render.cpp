@@ -0,0 +1,102 @@
+/*
+
+Tobis General Display
+by Arnold Schommer, Tobias Kuch
+
+render.cpp - drawing image files from the filesystem on the display: what depends on the display (see rendercore.h), ucg variant
+
+taken out of color.ino to be compilable without the rest of the sketch (see host/)
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include "esplayer.h"
+#include <Ucglib.h>         // https://github.com/olikraus/ucglib
+extern UCG_DECLARATION;
+#include "gfxlayer.h"
+#include "render.h"
+#include "metrics.h"
+#include "log.h"
+
+//#############################################################################
+// draw a tile already loaded to a small memory buffer - called/required by jpegRender()
+// colors are "recieved" as RGB565
+void drawRGBTile(int16_t x, int16_t y, uint16_t *pImg, int16_t width, int16_t height)
+{
+    // Serial.println("drawRGBTile("+String(x)+", "+String(y)+", *pImg, "+String(width)+", "+String(height)+")");
+    // the columns of the tile on the screen: cx_begin..cx_end-1 - clipped once, not per pixel
+    // (with DISPLAY_WIDTH/DISPLAY_HEIGHT in config.h, the screen size is a constant)
+    int16_t cx_begin = (x < 0) ? -x : 0,
+            cx_end   = (x + width <= (int16_t)gfx_getScreenWidth()) ? width : (int16_t)gfx_getScreenWidth() - x;
+
+    for(; height > 0; ++y, --height, pImg += width)
+    {
+        if(y >= (int16_t)gfx_getScreenHeight())  return; // abort if screen is left
+        if(y < 0)   continue;
+
+        for(int16_t cx = cx_begin; cx < cx_end; ++cx)
+        {
+            uint8_t red   = ((pImg[cx] >> 8) & 0xf8),
+                    green = ((pImg[cx] >> 3) & 0xfc),
+                    blue  = ((pImg[cx] << 3) & 0xf8);
+            gfx_setPixelColor(red, green, blue);
+            gfx_setPixel(x+cx, y);
+        }
+    }
+}
+
+//#############################################################################
+
+size_t render_arena_needed(void)
+{   // BMP: a row read (JPEG needs nothing: the tiles are drawn directly)
+    return 3*(gfx_getScreenWidth()+8);
+}
+
+void drawBitmap_SPIFFS(const char *filename)
+{
+  struct bmpImage bmp;
+  const uint8_t *data;
+  bool complete = true;     // every row was read
+
+  if(!bmp_open(filename, &bmp)) return;
+  metrics_render_stage(STAGE_HEADER);
+  gfx_clearBuffer();
+  for (uint16_t row = bmp.view.y0; row < bmp.view.y1; row++) // for each line
+  {
+    if(!(data = bmp_read_row(&bmp, row)))
+    {
+        LOG_ERROR("Err: BMP %s: can't read row %u", filename, row);
+        complete = false;
+        break;
+    }
+
+    uint8_t bits = 0;
+    for (uint16_t col = bmp.x0; col < bmp.view.x1; col++) // for each pixel
+    {
+      switch (bmp.depth)
+      {
+        case 1: // one bit per pixel b/w format
+            if (0 == col % 8)
+                bits = *data++;
+            if(bits & 0x80)
+                gfx_setPixelColor(bmp.palette[1][0], bmp.palette[1][1], bmp.palette[1][2]);
+            else
+                gfx_setPixelColor(bmp.palette[0][0], bmp.palette[0][1], bmp.palette[0][2]);
+            bits <<= 1;
+            break;
+        case 24: // standard BMP format: blue, green, red
+            gfx_setPixelColor(data[2], data[1], data[0]);
+            data += 3;
+            break;
+      }
+      if(col >= bmp.view.x0)
+          gfx_setPixel(col+bmp.view.offset_x, row+bmp.view.offset_y);
+    } // end pixel
+  } // end line
+  metrics_render_stage(STAGE_DECODE);
+  render_flush(complete); // Show results :)
+  metrics_render_stage(STAGE_FLUSH);
+  bmp_close(&bmp);
+}
@@ -0,0 +1,24 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+render.h - drawing image files from the filesystem on the display (render.cpp, JPEG_functions.cpp), ucg variant
+
+*/
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "rendercore.h"     // (what both variants share)
+
+void drawBitmap_SPIFFS(const char *filename);
+void drawJpeg_SPIFFS(const char *filename);
+
+// draw a tile already loaded to a small memory buffer - called/required by jpegRender()
+void drawRGBTile(int16_t x, int16_t y, uint16_t *pImg, int16_t width, int16_t height);
+
+void jpegRender(int xpos, int ypos);
+void jpegInfo(void);
+
+#endif RENDER_H
@@ -0,0 +1,283 @@
+/*
+
+Tobis General Display
+by Arnold Schommer, Tobias Kuch
+
+rendercore.cpp - the part of drawing that does not depend on the display, implementation
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include "esplayer.h"
+#include <Ucglib.h>         // https://github.com/olikraus/ucglib
+extern UCG_DECLARATION;
+#include "gfxlayer.h"
+#include "render.h"
+#include "imagecache.h"
+#include "metrics.h"
+#include "log.h"
+
+static uint16_t read16(File f)
+{
+  // BMP data is stored little-endian, same as Arduino.
+  uint16_t result;
+  ((uint8_t *)&result)[0] = f.read(); // LSB
+  ((uint8_t *)&result)[1] = f.read(); // MSB
+  return result;
+}
+
+static uint32_t read32(File f)
+{
+  // BMP data is stored little-endian, same as Arduino.
+  uint32_t result;
+  ((uint8_t *)&result)[0] = f.read(); // LSB
+  ((uint8_t *)&result)[1] = f.read();
+  ((uint8_t *)&result)[2] = f.read();
+  ((uint8_t *)&result)[3] = f.read(); // MSB
+  return result;
+}
+
+BMPHeader ReadBitmapSpecs(String filename)
+{
+  File file;
+  BMPHeader BMPData;
+  file = ESP_FS.open(filename, "r");
+  if (!file)
+  {
+    file.close();
+    return BMPData;
+  }
+  // Parse BMP header
+  if (read16(file) == 0x4D42) // BMP signature
+  {
+    BMPData.fileSize = read32(file);
+    BMPData.creatorBytes = read32(file);
+    BMPData.imageOffset = read32(file); // Start of image data
+    BMPData.headerSize = read32(file);
+    BMPData.width  = read32(file);
+    BMPData.height = read32(file);
+    BMPData.planes = read16(file);
+    BMPData.depth = read16(file); // bits per pixel
+    BMPData.format = read32(file);
+  }
+  file.close();
+  return BMPData;
+}
+
+//#############################################################################
+// video wall
+
+static uint8_t wall_cols = 1, wall_rows = 1, wall_col = 0, wall_row = 0;
+
+void render_set_wall(uint8_t cols, uint8_t rows, uint8_t col, uint8_t row)
+{
+    if(!cols || !rows || (col >= cols) || (row >= rows))    cols = rows = 1, col = row = 0;  // invalid: a single display
+    esp_enter_critical();   // (set by the settings page handler)
+    wall_cols = cols; wall_rows = rows;
+    wall_col  = col;  wall_row  = row;
+    esp_exit_critical();
+    image_cache_changed();  // (the images cached show another part)
+}
+
+bool render_view(uint32_t width, uint32_t height, struct renderView *view)
+{
+    int32_t screen_w = gfx_getScreenWidth(),
+            screen_h = gfx_getScreenHeight(),
+            cols, rows, col, row;
+
+    esp_enter_critical();
+    cols = wall_cols; rows = wall_rows;
+    col  = wall_col;  row  = wall_row;
+    esp_exit_critical();
+    // the image centered on the whole wall, moved by the position of this display
+    view->offset_x = (cols * screen_w - (int32_t)width )/2 - col * screen_w;
+    view->offset_y = (rows * screen_h - (int32_t)height)/2 - row * screen_h;
+    view->x0 = constrain(-view->offset_x,            (int32_t)0, (int32_t)width);
+    view->x1 = constrain(screen_w - view->offset_x,  (int32_t)0, (int32_t)width);
+    view->y0 = constrain(-view->offset_y,            (int32_t)0, (int32_t)height);
+    view->y1 = constrain(screen_h - view->offset_y,  (int32_t)0, (int32_t)height);
+    return (view->x0 < view->x1) && (view->y0 < view->y1);
+}
+
+bool render_fits(uint32_t width, uint32_t height)
+{
+    uint32_t cols, rows;
+
+    esp_enter_critical();
+    cols = wall_cols; rows = wall_rows;
+    esp_exit_critical();
+    return (width <= cols * gfx_getScreenWidth()) && (height <= rows * gfx_getScreenHeight());
+}
+
+//#############################################################################
+// scratch memory: the buffers needed while drawing an image are carved from it one after another;
+// drawing the next image starts at its beginning again
+
+#define RENDER_ARENA_ALIGN  4
+
+static uint8_t *arena = NULL;
+static size_t arena_size, arena_used = 0;
+
+bool render_arena_begin(void)
+{
+    if(arena)   return true;
+    arena_size = RENDER_ARENA_SIZE ? RENDER_ARENA_SIZE : render_arena_needed() + 4*RENDER_ARENA_ALIGN;
+    if(esp_psram_size())    arena = (uint8_t *)esp_psram_malloc(arena_size);
+    if(!arena)  arena = (uint8_t *)malloc(arena_size);
+    if(!arena)
+    {
+        LOG_ERROR("can't reserve %u bytes for drawing", (unsigned)arena_size);
+        return false;
+    }
+    return true;
+}
+
+void render_arena_reset(void)
+{
+    arena_used = 0;
+}
+
+void *render_arena_alloc(size_t size)
+{
+    void *p;
+
+    if(!render_arena_begin())   return NULL;
+    size = (size + RENDER_ARENA_ALIGN-1) & ~(RENDER_ARENA_ALIGN-1);
+    if(size > arena_size - arena_used)  return NULL;
+    p = arena + arena_used;
+    arena_used += size;
+    return p;
+}
+
+//#############################################################################
+// BMP files
+
+bool bmp_open(const char *filename, struct bmpImage *bmp)
+{
+    uint32_t header_size, format;
+    uint16_t planes;
+    int32_t height;
+
+    bmp->file = ESP_FS.open(filename, "r");
+    if(!bmp->file)
+    {
+        LOG_ERROR("Filesytem Error: can't open %s", filename);
+        return false;
+    }
+    metrics_render_stage(STAGE_OPEN);
+    if(read16(bmp->file) != 0x4D42) // BMP signature
+    {
+        LOG_ERROR("Err: BMP %s", filename);
+        bmp_close(bmp);
+        return false;
+    }
+    read32(bmp->file);                      // file size
+    read32(bmp->file);                      // creator bytes
+    bmp->offset = read32(bmp->file);        // start of image data
+    header_size = read32(bmp->file);
+    bmp->width = read32(bmp->file);
+    height = (int32_t)read32(bmp->file);    // negative: stored top-to-bottom
+    planes = read16(bmp->file);
+    bmp->depth = read16(bmp->file);         // bits per pixel
+    format = read32(bmp->file);             // compression format; 0=uncompressed
+    if((planes != 1) || (format != 0) ||                // uncompressed is handled
+       ((bmp->depth != 1) && (bmp->depth != 24)))      // only 1 or 24bits color depth impplemented
+    {
+        LOG_ERROR("Err: BMP %s", filename);
+        bmp_close(bmp);
+        return false;
+    }
+    bmp->top_down = height < 0;
+    bmp->height = bmp->top_down ? -height : height;
+    bmp->row_size = (bmp->width * bmp->depth + 31) / 32 * 4;   // rows are padded to 4 bytes
+    LOG_DEBUG("BMP %s: image offset %lu, header size %lu, bit depth %u, image size %lu*%lu",
+              filename, (unsigned long)bmp->offset, (unsigned long)header_size, bmp->depth,
+              (unsigned long)bmp->width, (unsigned long)bmp->height);
+
+    if(bmp->depth == 1)
+    {   // the palette: blue, green, red, unused per entry
+        uint8_t palette[8];
+
+        bmp->file.seek(14 + header_size, SeekSet);
+        bmp->file.read(palette, sizeof(palette));
+        for(uint8_t i = 0; i < 2; ++i)
+        {
+            bmp->palette[i][0] = palette[4*i+2];
+            bmp->palette[i][1] = palette[4*i+1];
+            bmp->palette[i][2] = palette[4*i];
+        }
+    }
+
+    // just the part shown is read; 1 bit per pixel: starting at a byte
+    if(!render_view(bmp->width, bmp->height, &bmp->view))   bmp->view.y1 = bmp->view.y0;
+    bmp->x0 = (bmp->depth == 1) ? (bmp->view.x0 & ~7) : bmp->view.x0;
+    render_arena_reset();   // (the first buffer of a BMP image)
+    bmp->row = (uint8_t *)render_arena_alloc(((bmp->view.x1 - bmp->x0) * bmp->depth + 7) / 8);
+    if(!bmp->row)
+    {
+        LOG_ERROR("can't alloc the row buffer; aborting drawing of %s", filename);
+        bmp_close(bmp);
+        return false;
+    }
+    return true;
+}
+
+const uint8_t *bmp_read_row(struct bmpImage *bmp, uint16_t y)
+{
+    uint32_t pos = bmp->offset +
+                   (bmp->top_down ? y : bmp->height - 1 - y) * bmp->row_size +
+                   bmp->x0 * bmp->depth / 8;
+    size_t len = ((bmp->view.x1 - bmp->x0) * bmp->depth + 7) / 8;
+
+    if(bmp->file.position() != pos) bmp->file.seek(pos, SeekSet);   // (consecutive rows shown in full: no seek)
+    return (bmp->file.read(bmp->row, len) == len) ? bmp->row : NULL;
+}
+
+void bmp_close(struct bmpImage *bmp)
+{
+    bmp->file.close();
+}
+
+//#############################################################################
+
+static bool render_flush_deferred = false;
+static bool render_complete;    // render_flush() was reached with the whole image drawn (to be cached)
+
+void render_flush(bool complete)
+{
+    render_complete = complete;
+    if(!render_flush_deferred)  gfx_flushBuffer();
+}
+
+void drawAnyImageType(const char *filename, bool flush)
+{
+    const char *ext = strrchr(filename, '.');
+    if(!ext)    return; // no extension => we're unable to detect the filetype => we can't call the *corresponding* display method
+    ++ext;  // skip '.' itself
+
+    struct imageCacheKey key;
+
+    render_flush_deferred = !flush;
+    render_complete = false;
+    if(image_cache_restore(filename, &key))
+    {
+        render_flush();
+        render_flush_deferred = false;
+        return;
+    }
+    if(strcasecmp(ext, "bmp") == 0)
+    {
+        metrics_render_begin(GFI_TYPE_BMP);
+        drawBitmap_SPIFFS(filename);
+    }
+    else if(strcasecmp(ext, "jpg") == 0 || strcasecmp(ext, "jpeg") == 0)
+    {
+        metrics_render_begin(GFI_TYPE_JPG);
+        drawJpeg_SPIFFS(filename);
+    }
+    metrics_render_end();
+    if(render_complete) image_cache_store(&key);
+    render_flush_deferred = false;
+}
@@ -0,0 +1,167 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+screenbuffer.cpp - an off-screen RGB565 buffer for displays drawn directly by ucglib (SCREEN_BUFFER in config.h)
+
+Drawing goes to the buffer; gfx_flushBuffer() sends what changed since the last flush - per row the columns
+between the first and the last pixel changed, each run of one color by one ucg.drawHLine() (one window, the
+color repeated) instead of a window per pixel. A pixel set to the color it already has is not sent again,
+so drawing the same image again (or a similar one) sends next to nothing, and the display shows an image
+at once instead of line by line.
+
+gfx_clearBuffer() does not clear the buffer right away (that would lose what the display shows): the pixels
+drawn afterwards are noted (a bit each), those not drawn become black when the image is complete.
+
+Text is drawn by ucglib directly to the display; the buffer does not know it, so drawing the next image
+sends every pixel.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include <stdlib.h>
+#include "esplayer.h"
+#include <Ucglib.h>         // https://github.com/olikraus/ucglib
+extern UCG_DECLARATION;
+#include "gfxlayer.h"
+#include "log.h"
+
+#ifdef SCREEN_BUFFER
+
+uint16_t *screen_buffer = NULL;
+struct screenSpan *screen_dirty = NULL;
+uint8_t *screen_drawn = NULL;
+uint16_t screen_color = 0xffff;
+static uint8_t *drawn_bits;                 // (screen_drawn, while it is used)
+static bool screen_unusable = false;        // no memory: don't try again
+static bool screen_text = false;            // text was drawn to the display
+
+static void screen_mark(uint16_t y, uint16_t x0, uint16_t x1)
+{
+    if(x0 < screen_dirty[y].x0) screen_dirty[y].x0 = x0;
+    if(x1 > screen_dirty[y].x1) screen_dirty[y].x1 = x1;
+}
+
+static void screen_reset(void)              // nothing changed
+{
+    for(uint16_t y = 0; y < gfx_getScreenHeight(); ++y)
+    {
+        screen_dirty[y].x0 = gfx_getScreenWidth();
+        screen_dirty[y].x1 = 0;
+    }
+}
+
+bool screen_begin(void)
+{
+    size_t size = 2 * gfx_getScreenWidth() * gfx_getScreenHeight();
+
+    if(screen_buffer)   return true;
+    if(screen_unusable) return false;
+    screen_unusable = true;
+    if(esp_psram_size())    screen_buffer = (uint16_t *)esp_psram_malloc(size);
+    if(!screen_buffer)  screen_buffer = (uint16_t *)malloc(size);
+    screen_dirty = (struct screenSpan *)malloc(gfx_getScreenHeight() * sizeof(*screen_dirty));
+    drawn_bits = (uint8_t *)malloc(size / 16 + 1);
+    if(!screen_buffer || !screen_dirty || !drawn_bits)
+    {
+        free(screen_buffer);
+        free(screen_dirty);
+        free(drawn_bits);
+        screen_buffer = NULL;
+        screen_dirty = NULL;
+        LOG_WARN("screen buffer: no memory for %u bytes, drawing directly", (unsigned)size);
+        return false;
+    }
+    memset(screen_buffer, 0, size);     // (as the display is cleared when starting)
+    screen_reset();
+    screen_unusable = false;
+    return true;
+}
+
+void screen_settle(void)
+{
+    uint16_t width = gfx_getScreenWidth();
+
+    if(!screen_drawn)   return;
+    for(uint16_t y = 0; y < gfx_getScreenHeight(); ++y)
+    {
+        uint16_t *row = screen_buffer + y * width;
+        uint32_t i = y * width;
+
+        for(uint16_t x = 0; x < width; ++x, ++i)
+            if(row[x] && !(screen_drawn[i/8] & (1 << (i & 7))))
+            {
+                row[x] = 0;
+                screen_mark(y, x, x+1);
+            }
+    }
+    screen_drawn = NULL;
+}
+
+void screen_flush(void)
+{
+    uint16_t width = gfx_getScreenWidth();
+
+    if(!screen_buffer)  return;
+    screen_settle();
+    for(uint16_t y = 0; y < gfx_getScreenHeight(); ++y)
+    {
+        const uint16_t *row = screen_buffer + y * width;
+        uint16_t x = screen_dirty[y].x0, x1 = screen_dirty[y].x1;
+
+        while(x < x1)
+        {   // a run of one color
+            uint16_t color = row[x], len = 1;
+
+            while((x + len < x1) && (row[x + len] == color))    ++len;
+            ucg.setColor((color >> 8) & 0xf8, (color >> 3) & 0xfc, (color << 3) & 0xf8);
+            ucg.drawHLine(x, y, len);
+            x += len;
+        }
+    }
+    screen_reset();
+}
+
+void screen_clear(bool display)
+{
+    uint16_t width = gfx_getScreenWidth();
+
+    if(!screen_begin())
+    {
+        ucg.clearScreen();
+        return;
+    }
+    if(display || screen_text)
+    {
+        if(display)
+        {   // at once, the buffer accordingly
+            ucg.clearScreen();
+            screen_reset();
+        }
+        else    screen_invalidate(false);   // unknown what the display shows: send everything
+        screen_text = false;
+        screen_drawn = NULL;
+        memset(screen_buffer, 0, 2 * width * gfx_getScreenHeight());
+        return;
+    }
+    // the buffer keeps what the display shows; what is not drawn anew becomes black by screen_settle()
+    screen_drawn = drawn_bits;
+    memset(screen_drawn, 0, (width * gfx_getScreenHeight() + 7) / 8);
+}
+
+void screen_invalidate(bool text)
+{
+    if(!screen_buffer)  return;
+    if(text)
+    {
+        screen_text = true;
+        return;
+    }
+    for(uint16_t y = 0; y < gfx_getScreenHeight(); ++y)
+        screen_mark(y, 0, gfx_getScreenWidth());
+}
+
+#endif
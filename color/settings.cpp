@@ -35,12 +35,19 @@ void debug_print_settings(void)
             Serial.print(" STARTUP_SHOW_SSID");
         if(SETTINGS_IS_AP_MODE && (MySettings.flags & SETTINGS_STARTUP_EXHIBIT_WIFI_PASSWORD))
             Serial.print(" STARTUP_EXHIBIT_WIFI_PASSWORD");
+        if(MySettings.flags & SETTINGS_SYNC_LEADER)
+            Serial.print(" SYNC_LEADER");
+        if(MySettings.flags & SETTINGS_SYNC_FOLLOWER)
+            Serial.print(" SYNC_FOLLOWER");
         Serial.print("\n");
     }
     Serial.print("WiFiAPSTAName\t");
     Serial.println(MySettings.WiFiAPSTAName[0] ? MySettings.WiFiAPSTAName : "(unset)");
     Serial.print("WiFiPwd\t");
     Serial.println(MySettings.WiFiPwd[0] ? "(set)" : "(unset)");
+    Serial.print("video wall\t");
+    Serial.println(String(MySettings.wall_cols)+"*"+String(MySettings.wall_rows)+" displays, this at "+
+                   String(MySettings.wall_col)+","+String(MySettings.wall_row));
     Serial.print("SettingsValid\t");
     Serial.print(MySettings.SettingsValid);
     Serial.println((strcmp(MySettings.SettingsValid, MAGIC_VALUE_SETTINGS_VALID) == 0) ? " - valid":" - invalid!");
@@ -53,6 +60,13 @@ bool loadSettings(void)
     EEPROM.begin(512);
     EEPROM.get(0, MySettings);
     EEPROM.end();
+    // (saved by an older version: the video wall fields are unset)
+    if(!MySettings.wall_cols || !MySettings.wall_rows ||
+       (MySettings.wall_col >= MySettings.wall_cols) || (MySettings.wall_row >= MySettings.wall_rows))
+    {
+        MySettings.wall_cols = MySettings.wall_rows = 1;
+        MySettings.wall_col  = MySettings.wall_row  = 0;
+    }
     // debug_print_settings();
     return strcmp(MySettings.SettingsValid, MAGIC_VALUE_SETTINGS_VALID) == 0;
 }
@@ -109,6 +123,10 @@ void SetDefaultSettings(void)
     SETTINGS_SET_SHOW_IP;
     SETTINGS_SET_SHOW_SSID;
     SETTINGS_UNSET_WIFI_PWD_EXHIBITED;
+    SETTINGS_PUT_SYNC_LEADER(false);
+    SETTINGS_PUT_SYNC_FOLLOWER(false);
+    MySettings.wall_cols = MySettings.wall_rows = 1;    // a single display, no video wall
+    MySettings.wall_col  = MySettings.wall_row  = 0;
 
     strncpy( MySettings.SettingsValid, MAGIC_VALUE_SETTINGS_VALID, sizeof(MySettings.SettingsValid) );
     MySettings.SettingsValid[strlen(MAGIC_VALUE_SETTINGS_VALID)+1] = '\0';
@@ -29,6 +29,9 @@ settings.h - definitions for the settings to be saved in EEPROM
 #define SETTINGS_STARTUP_SHOW_SSID              32
 // show the AP password on the startup screen? (only, if in AP mode)
 #define SETTINGS_STARTUP_EXHIBIT_WIFI_PASSWORD  64
+// synchronized slideshows (see sync.h): does this device lead them or follow the leader? (neither: plays on its own)
+#define SETTINGS_SYNC_LEADER                    128
+#define SETTINGS_SYNC_FOLLOWER                  256
 
 // access macros to test/set/clear those flags:
 // generic:
@@ -72,6 +75,11 @@ settings.h - definitions for the settings to be saved in EEPROM
 #define SETTINGS_PUT_WIFI_PWD_EXHIBITION(state) SETTINGS_PUT_FLAG(SETTINGS_STARTUP_EXHIBIT_WIFI_PASSWORD, state)
 #define SETTINGS_SET_WIFI_PWD_EXHIBITED         SETTINGS_SET_FLAG(SETTINGS_STARTUP_EXHIBIT_WIFI_PASSWORD)
 #define SETTINGS_UNSET_WIFI_PWD_EXHIBITED       SETTINGS_CLEAR_FLAG(SETTINGS_STARTUP_EXHIBIT_WIFI_PASSWORD)
+// synchronized slideshows
+#define SETTINGS_IS_SYNC_LEADER                 SETTINGS_TEST(SETTINGS_SYNC_LEADER)
+#define SETTINGS_IS_SYNC_FOLLOWER               SETTINGS_TEST(SETTINGS_SYNC_FOLLOWER)
+#define SETTINGS_PUT_SYNC_LEADER(state)         SETTINGS_PUT_FLAG(SETTINGS_SYNC_LEADER, state)
+#define SETTINGS_PUT_SYNC_FOLLOWER(state)       SETTINGS_PUT_FLAG(SETTINGS_SYNC_FOLLOWER, state)
 
 static const char WiFiPwdLen = WIFIPWDLEN;
 static const char APSTANameLen = APSTANAMELEN;
@@ -85,6 +93,8 @@ struct EEPromData
     char WiFiAPSTAName[APSTANameLen];   // STATION /AP name to connect, if definded
     char WiFiPwd[WiFiPwdLen];           // WiFiPAssword, if definded
     char SettingsValid[5];              // magic value for naive check of validity of the data structure
+    uint8_t wall_cols, wall_rows;       // video wall (see render.h): displays side by side / one above the other
+    uint8_t wall_col, wall_row;         // the position of this one (0,0: top left)
   };
 
 extern struct EEPromData MySettings;
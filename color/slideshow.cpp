@@ -0,0 +1,329 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+slideshow.cpp - showing the images one after another, implementation
+
+A playlist is not read into RAM: slideshow_position is the offset of the next line within the file,
+so it may be as long as the filesystem allows. Without a playlist it is the position in the image index.
+
+Drawing is started ahead of the deadline by the time the image took last (plus a margin), into the
+buffer only; the display is updated at the deadline. If the estimate was too low, the slide is simply
+shown as soon as it is drawn - and the next estimate is the (longer) time measured.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "esplayer.h"
+#include <Ucglib.h>         // https://github.com/olikraus/ucglib
+extern UCG_DECLARATION;
+#include "gfxlayer.h"
+#include "imageindex.h"
+#include "render.h"
+#include "slideshow.h"
+#include "log.h"
+
+#define SLIDESHOW_LINE_SIZE     (MAX_FILENAME_LEN+16)   // room for a duration; longer lines are cut
+#define RENDER_COST_SLOTS       32      // images whose drawing time is remembered (more share the slots)
+#define RENDER_AHEAD_MARGIN     10      // ms to start drawing earlier than estimated
+
+// set by the HTTP handlers, taken over by slideshow_loop()
+#define SLIDESHOW_CMD_START     1
+#define SLIDESHOW_CMD_STOP      2
+static volatile uint8_t pending_cmd = 0;
+static char pending_playlist[MAX_FILENAME_LEN+1];
+
+// used by loop() only
+static bool slideshow_is_running = false;
+static bool slideshow_following = false;    // the slides are set by slideshow_follow() (see sync.h)
+static char slideshow_playlist[MAX_FILENAME_LEN+1];    // "": all images of the index
+static uint32_t slideshow_position;     // of the next slide: index position / file offset of its line
+static uint32_t slideshow_deadline;     // when to show the next slide
+static struct
+{
+    char filename[MAX_FILENAME_LEN+1];
+    uint32_t duration;
+    bool known;                         // filename and duration are read from the index/playlist (or followed)
+    bool drawn;                         // it is in the buffer, waiting for the deadline
+} slideshow_next;
+
+// the time (ms) drawing took, per image (by a hash of the filename) and for the last one of any
+struct renderCost
+{
+    uint32_t hash;
+    uint16_t ms;
+};
+static renderCost render_costs[RENDER_COST_SLOTS];
+static uint16_t render_cost_last = 0;
+
+void slideshow_start(const char *playlist)
+{
+    esp_enter_critical();
+    strncpy(pending_playlist, playlist ? playlist : "", MAX_FILENAME_LEN);
+    pending_playlist[MAX_FILENAME_LEN] = '\0';
+    pending_cmd = SLIDESHOW_CMD_START;
+    esp_exit_critical();
+    esp_signal_event();
+}
+
+void slideshow_stop(void)
+{
+    pending_cmd = SLIDESHOW_CMD_STOP;
+    esp_signal_event();
+}
+
+bool slideshow_running(void)
+{
+    uint8_t cmd = pending_cmd;
+
+    return cmd ? (cmd == SLIDESHOW_CMD_START) : slideshow_is_running;
+}
+
+bool slideshow_is_playlist(const char *filename)
+{
+    const char *ext = strrchr(filename, '.');
+
+    return ext && !strcasecmp(ext, SLIDESHOW_PLAYLIST_EXT);
+}
+
+// take over what the handlers ordered
+static void slideshow_apply_pending(void)
+{
+    uint8_t cmd;
+
+    if(!pending_cmd)    return;
+    esp_enter_critical();
+    cmd = pending_cmd;
+    pending_cmd = 0;
+    strcpy(slideshow_playlist, pending_playlist);
+    esp_exit_critical();
+
+    if(cmd == SLIDESHOW_CMD_STOP)
+    {
+        slideshow_is_running = false;
+        LOG_INFO("slideshow stopped");
+        return;
+    }
+    if(!*slideshow_playlist && ESP_FS.exists(SLIDESHOW_DEFAULT_PLAYLIST))
+        strcpy(slideshow_playlist, SLIDESHOW_DEFAULT_PLAYLIST);
+    slideshow_is_running = true;
+    slideshow_following = false;
+    slideshow_next.known = slideshow_next.drawn = false;
+    slideshow_position = 0;
+    slideshow_deadline = millis();      // the first slide at once
+    LOG_INFO("slideshow started: %s", *slideshow_playlist ? slideshow_playlist : "all images");
+}
+
+// split a playlist line into filename and duration; false, if it is empty or a comment
+static bool slideshow_parse_line(char *line, char *filename, uint32_t *duration)
+{
+    char *end, *number;
+
+    while(isspace(*line))   line++;
+    if(!*line || (*line == '#'))    return false;
+    end = line + strlen(line);
+    while((end > line) && isspace(end[-1])) *--end = '\0';
+
+    // a number at the end, separated by blanks: the duration
+    *duration = SLIDESHOW_PERIOD;
+    number = end;
+    while((number > line) && isdigit(number[-1]))   number--;
+    if((number < end) && (number > line) && isspace(number[-1]))
+    {
+        *duration = strtoul(number, NULL, 10);
+        end = number;
+        while((end > line) && isspace(end[-1])) *--end = '\0';
+    }
+
+    *filename = '\0';
+    if(*line != '/')    strcpy(filename, "/");
+    strncat(filename, line, MAX_FILENAME_LEN - strlen(filename));
+    return true;
+}
+
+// the next slide of the playlist; false, if it has none (or cannot be read)
+static bool slideshow_next_from_playlist(char *filename, uint32_t *duration)
+{
+    char line[SLIDESHOW_LINE_SIZE];
+    bool wrapped = false;
+    File file = ESP_FS.open(slideshow_playlist, "r");
+
+    if(!file)
+    {
+        LOG_WARN("slideshow: can't open playlist %s", slideshow_playlist);
+        return false;
+    }
+    while(true)
+    {
+        size_t len = 0;
+        int c;
+
+        if(!file.seek(slideshow_position, SeekSet)) slideshow_position = 0;
+        while(((c = file.read()) >= 0) && (c != '\n'))
+            if(len < sizeof(line)-1)    line[len++] = c;
+        line[len] = '\0';
+        if((c < 0) && !len)     // end of file: start again - once
+        {
+            if(wrapped || !slideshow_position)  break;
+            wrapped = true;
+            slideshow_position = 0;
+            continue;
+        }
+        slideshow_position = file.position();
+        if(slideshow_parse_line(line, filename, duration))
+        {
+            file.close();
+            return true;
+        }
+    }
+    file.close();
+    LOG_WARN("slideshow: playlist %s is empty", slideshow_playlist);
+    return false;
+}
+
+// the next slide of the image index
+static bool slideshow_next_from_index(char *filename, uint32_t *duration)
+{
+    struct imageIndexRecord image;
+
+    if(slideshow_position >= image_index_count())   slideshow_position = 0;
+    if(!image_index_get(slideshow_position++, &image))  return false;
+    strcpy(filename, image.filename);
+    *duration = SLIDESHOW_PERIOD;
+    return true;
+}
+
+static uint32_t render_cost_hash(const char *filename)     // FNV-1a
+{
+    uint32_t hash = 2166136261u;
+
+    while(*filename)    hash = (hash ^ (uint8_t)*filename++) * 16777619u;
+    return hash;
+}
+
+// how long drawing filename will take (ms): as last time - or as the last image, if it was not drawn yet
+static uint32_t render_cost_estimate(const char *filename)
+{
+    uint32_t hash = render_cost_hash(filename);
+    const renderCost &slot = render_costs[hash % RENDER_COST_SLOTS];
+    uint16_t ms = (slot.hash == hash) ? slot.ms : render_cost_last;
+
+    return ms + ms/8 + RENDER_AHEAD_MARGIN;
+}
+
+// a longer time is taken at once (to be late once only), a shorter one in steps (a single quick run may be luck)
+static void render_cost_add(const char *filename, uint32_t ms)
+{
+    uint32_t hash = render_cost_hash(filename);
+    renderCost &slot = render_costs[hash % RENDER_COST_SLOTS];
+
+    if(ms > UINT16_MAX) ms = UINT16_MAX;
+    if((slot.hash != hash) || (ms > slot.ms))   slot.ms = ms;
+    else                                        slot.ms = (3*slot.ms + ms) / 4;
+    slot.hash = hash;
+    render_cost_last = ms;
+}
+
+void slideshow_suspend(void)
+{
+    slideshow_apply_pending();
+    slideshow_next.drawn = false;       // the buffer is drawn over
+    slideshow_deadline = millis() + SLIDESHOW_PERIOD;
+}
+
+void slideshow_drawn_over(void)
+{
+    slideshow_next.drawn = false;       // (drawn again when due - the deadline stays)
+}
+
+bool slideshow_next_slide(char *filename, uint32_t *deadline)
+{
+    if(!slideshow_is_running || !slideshow_next.known)  return false;
+    strcpy(filename, slideshow_next.filename);
+    *deadline = slideshow_deadline;
+    return true;
+}
+
+void slideshow_follow(const char *filename, uint32_t deadline)
+{
+    slideshow_apply_pending();
+    if(!slideshow_is_running || !slideshow_following)
+    {
+        LOG_INFO("slideshow: following the leader");
+        slideshow_is_running = slideshow_following = true;
+        slideshow_next.known = slideshow_next.drawn = false;
+    }
+    if(!slideshow_next.known || strcmp(slideshow_next.filename, filename))
+    {
+        if(time_reached(millis(), deadline))    return;     // (the slide shown just now, repeated)
+        strcpy(slideshow_next.filename, filename);
+        slideshow_next.known = true;
+        slideshow_next.drawn = false;
+    }
+    slideshow_deadline = deadline;      // (maybe just corrected by a better estimate of the leader's clock)
+}
+
+void slideshow_unfollow(void)
+{
+    slideshow_apply_pending();
+    if(!slideshow_following)    return;
+    slideshow_following = false;
+    slideshow_next.known = slideshow_next.drawn = false;    // (the leader's next slide: chosen anew)
+    if(slideshow_is_running)    LOG_INFO("slideshow: continuing on its own");
+}
+
+uint32_t slideshow_idle_time(void)
+{
+    uint32_t due, now = millis();
+
+    if(pending_cmd || (slideshow_is_running && !slideshow_following && !slideshow_next.known))  return 0;
+    if(!slideshow_is_running || !slideshow_next.known)  return UINT32_MAX;
+    due = slideshow_deadline;
+    if(!slideshow_next.drawn)   due -= render_cost_estimate(slideshow_next.filename);
+    return time_reached(now, due) ? 0 : due - now;
+}
+
+bool slideshow_loop(void)
+{
+    slideshow_apply_pending();
+    if(!slideshow_is_running)   return false;
+
+    if(!slideshow_next.known)   // what comes next decides when to start drawing
+    {
+        if(slideshow_following) return false;   // told by slideshow_follow()
+        if(!(*slideshow_playlist ? slideshow_next_from_playlist(slideshow_next.filename, &slideshow_next.duration)
+                                 : slideshow_next_from_index(slideshow_next.filename, &slideshow_next.duration)))
+        {
+            slideshow_is_running = false;
+            LOG_INFO("slideshow stopped: nothing to show");
+            return false;
+        }
+        slideshow_next.known = true;
+    }
+    if(!slideshow_next.drawn)
+    {
+        uint32_t start = millis();
+
+        if(!time_reached(start, slideshow_deadline - render_cost_estimate(slideshow_next.filename)))  return false;
+        drawAnyImageType(slideshow_next.filename, false);
+        render_cost_add(slideshow_next.filename, millis() - start);
+        slideshow_next.drawn = true;
+        if(!time_reached(millis(), slideshow_deadline)) return true;    // in time: shown by a later call
+        LOG_DEBUG("slideshow: %s drawn %ld ms late", slideshow_next.filename, (long)(millis() - slideshow_deadline));
+    }
+    else if(!time_reached(millis(), slideshow_deadline))    return false;
+
+    gfx_flushBuffer();
+    slideshow_next.known = slideshow_next.drawn = false;
+    if(slideshow_following) return true;    // the leader tells the next deadline
+    slideshow_deadline += slideshow_next.duration;
+    // drawing took longer than the whole slide: show this one for its duration from now on, instead of
+    // hurrying through the following ones to catch up
+    if(time_reached(millis(), slideshow_deadline))  slideshow_deadline = millis() + slideshow_next.duration;
+    return true;
+}
@@ -0,0 +1,40 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+stream.h - live frames: pushed over the network and written straight to the display, without a file
+
+The frames are sent in packets, by UDP (port STREAM_PORT) or as binary messages of the WebSocket /stream;
+both carry the same packets: an 8 byte header (little endian) and a piece of the frame.
+
+    uint8_t  magic      'F'
+    uint8_t  flags      1: XOR - the bytes are XORed to the previous frame (0: unchanged)
+                        2: RLE - the bytes are PackBits compressed (the offset is that of the decoded bytes)
+                        128: the last packet of the frame - it is shown now
+    uint16_t frame      the frame number, counting up by 1 - an XOR frame needs the one before
+    uint32_t offset     where the piece belongs within the frame (bytes)
+
+The frame is the native format of the display, so nothing is to be converted:
+- bw: the u8g2 buffer, 1 bit per pixel; per 8 rows, one byte per column (bit 0: the top row)
+- color: RGB565, little endian, row by row
+A packet may be STREAM_PACKET_MAX bytes long, so a bw frame of 128x64 (1 KB) fits into one. XOR frames (with
+RLE, mostly a few bytes) are applied only if the frame before was received completely; after a lost packet,
+they are ignored until a frame without XOR comes. Connecting to the WebSocket, the client gets the display
+size and format as text, e.g. "128x64 page1" or "128x128 rgb565".
+
+As soon as frames come in, the slideshow is stopped.
+
+*/
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#define STREAM_PACKET_MAX       1472    // bytes: fits into a UDP packet without fragmentation
+
+void stream_begin(WEBSERVER_CLASS &server);     // listen to UDP and add the WebSocket to server
+void stream_loop(void);                 // draw the frames received - to be called from loop()
+uint32_t stream_idle_time(void);        // ms until stream_loop() has something to do (UINT32_MAX: nothing, no stream)
+void stream_invalidate(void);           // something else was drawn: the next frame has to be a complete one
+
+#endif STREAM_H
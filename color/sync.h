@@ -0,0 +1,25 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+sync.h - synchronized slideshows: one device (the leader) tells the others on the same network (the
+followers) what to show when, by UDP multicast
+
+The leader sends its clock (millis()) and its next slide - filename and deadline - every SYNC_INTERVAL ms
+and as soon as the next slide is known. A follower estimates the difference between the leader's clock
+and its own and shows the same file at the same instant; it needs the same files, of course. No time
+server is needed: the leader's clock is the reference. The followers' own slideshows are overridden:
+they start and stop with the leader's.
+
+The role (leader, follower or neither) is chosen on the settings page.
+
+*/
+
+#ifndef SYNC_H
+#define SYNC_H
+
+void sync_loop(void);           // send or receive - to be called from loop()
+uint32_t sync_idle_time(void);  // ms until sync_loop() has something to do (UINT32_MAX: nothing)
+
+#endif SYNC_H
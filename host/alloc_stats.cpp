@@ -0,0 +1,66 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+alloc_stats.cpp - heap usage of the render code, for the benchmark (see alloc_stats.h)
+
+*/
+
+#include <stdlib.h>
+#include <malloc.h>
+#include <new>
+#include "alloc_stats.h"
+
+allocStats alloc_stats;
+
+extern "C"
+{
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static void *account(void *ptr)
+{
+    if(ptr)
+    {
+        alloc_stats.current += malloc_usable_size(ptr);
+        if(alloc_stats.current > alloc_stats.peak)  alloc_stats.peak = alloc_stats.current;
+        ++alloc_stats.count;
+    }
+    return ptr;
+}
+
+void *__wrap_malloc(size_t size)            { return account(__real_malloc(size)); }
+void *__wrap_calloc(size_t n, size_t size)  { return account(__real_calloc(n, size)); }
+
+void __wrap_free(void *ptr)
+{
+    if(ptr) alloc_stats.current -= malloc_usable_size(ptr);
+    __real_free(ptr);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t old = ptr ? malloc_usable_size(ptr) : 0;
+    void *moved = __real_realloc(ptr, size);
+
+    if(!moved && size)  return NULL;    // the old block is still there
+    alloc_stats.current -= old;
+    return account(moved);
+}
+}
+
+void *operator new(size_t size)
+{
+    void *ptr = __wrap_malloc(size ? size : 1);
+    if(!ptr)    throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size)               { return operator new(size); }
+void operator delete(void *ptr) noexcept        { __wrap_free(ptr); }
+void operator delete[](void *ptr) noexcept      { __wrap_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept    { __wrap_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept  { __wrap_free(ptr); }
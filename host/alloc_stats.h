@@ -0,0 +1,29 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+alloc_stats.h - heap usage of the render code, for the benchmark
+
+Only linked into the benchmark: malloc() & co. are wrapped (ld --wrap) and operator new is replaced,
+so every allocation of the render code, JPEGDecoder and String is accounted for.
+
+*/
+
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <stddef.h>
+
+struct allocStats
+{
+    size_t current;         // bytes allocated now
+    size_t peak;            // maximum of current since the last alloc_stats_reset_peak()
+    unsigned long count;    // number of allocations since the last alloc_stats_reset_peak()
+};
+
+extern allocStats alloc_stats;
+
+inline void alloc_stats_reset_peak(void)    { alloc_stats.peak = alloc_stats.current; alloc_stats.count = 0; }
+
+#endif ALLOC_STATS_H
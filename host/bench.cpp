@@ -0,0 +1,139 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+bench.cpp - throughput of the render code on the host, per stage, image type and size
+
+usage: bench_<variant> [-c corpus] [-n iterations] [-g]
+
+The images are those of the corpus directory (see corpus.h), BMP and JPEG. "make corpus" adds JPEG files
+made from the 24 bit BMPs using ImageMagick, with different MCU layouts (4:4:4, 4:2:2, 4:2:0).
+With -g, the BMP files are generated only.
+
+Per stage and image, one warm-up run is followed by the measured ones; reported are the average time,
+the source pixels per second, the calls to the display per run and the peak of heap memory used by the
+stage above what was allocated before (the warm-up run included, so one-time allocations count, too).
+
+stages:
+  bmp       drawBitmap_SPIFFS(), i.e. reading, dithering (bw) and drawing a BMP file
+  jpeg      drawJpeg_SPIFFS(), i.e. decoding, dithering (bw) and drawing a JPEG file
+  dither    (bw) framebuffer_to_display() of a full screen, i.e. dithering & drawing what the JPEG decoder delivered
+  tile      (color) drawRGBTile() of a full screen, i.e. drawing what the JPEG decoder delivered
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "esplayer.h"
+#if defined(VARIANT_bw)
+#include <U8g2lib.h>
+U8G2_CONSTRUCTION;
+#define gfx_device      u8g2
+#elif defined(VARIANT_color)
+#include <Ucglib.h>
+UCG_CONSTRUCTION;
+#define gfx_device      ucg
+#else
+#error "define VARIANT_bw or VARIANT_color"
+#endif
+#include "gfxlayer.h"
+#include "render.h"
+#include "alloc_stats.h"
+#include "corpus.h"
+
+// run one stage: one warm-up plus iterations measured runs
+template<typename F> static void measure(const char *stage, const String &name, uint32_t pixels, int iterations, F run)
+{
+    unsigned long duration;
+    size_t base = alloc_stats.current;
+
+    alloc_stats_reset_peak();
+    run();
+    gfx_device.resetCounts();
+    unsigned long start = micros();
+    for(int i = 0; i < iterations; ++i)
+        run();
+    duration = micros() - start;
+
+    double us = (double)duration / iterations;
+    printf("%-7s %-28s %8u %10.1f %9.2f %9lu",
+           stage, name.c_str(), pixels, us, us > 0 ? pixels / us : 0.0, gfx_device.pixelCount() / iterations);
+#if defined(VARIANT_bw)
+    printf(" %7lu", gfx_device.sendCount() / iterations);
+#else
+    printf(" %7s", "-");
+#endif
+    printf(" %9zu\n", alloc_stats.peak - base);
+}
+
+static void usage(const char *self)
+{
+    fprintf(stderr, "usage: %s [-c corpus] [-n iterations] [-g]\n"
+                    "  -c corpus      directory of the test images (default: corpus)\n"
+                    "  -n iterations  measured runs per stage and image (default: 10)\n"
+                    "  -g             just generate the BMP files of the corpus\n", self);
+}
+
+int main(int argc, char **argv)
+{
+    const char *corpus = "corpus";
+    int opt, iterations = 10;
+    bool generate_only = false;
+
+    while((opt = getopt(argc, argv, "c:n:g")) != -1)
+        switch(opt)
+        {
+        case 'c':   corpus = optarg;                break;
+        case 'n':   iterations = atoi(optarg);      break;
+        case 'g':   generate_only = true;           break;
+        default:    usage(argv[0]);                 return 2;
+        }
+    if(iterations < 1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    if(!corpus_open(corpus))    return 1;
+    if(generate_only)   return 0;
+
+    Serial.quiet = true;
+    gfx_init();
+    printf("display %ux%u, %d runs each\n", gfx_getScreenWidth(), gfx_getScreenHeight(), iterations);
+    printf("%-7s %-28s %8s %10s %9s %9s %7s %9s\n",
+           "stage", "image", "pixels", "us/run", "Mpixel/s", "pixels", "flushes", "heap");
+
+    for(const corpusImage &image : corpus_find(".bmp"))
+        measure("bmp", image.filename, image.width*image.height, iterations,
+                [&]() { drawBitmap_SPIFFS(image.filename.c_str()); });
+    for(const corpusImage &image : corpus_find(".jpg"))
+        measure("jpeg", image.filename, image.width*image.height, iterations,
+                [&]() { drawJpeg_SPIFFS(image.filename.c_str()); });
+
+    // what the JPEG path does after decoding, for the full screen
+    uint16_t width = gfx_getScreenWidth(), height = gfx_getScreenHeight();
+    std::vector<uint16_t> tile(width*height);
+    for(uint16_t y = 0; y < height; ++y)
+        for(uint16_t x = 0; x < width; ++x)
+        {
+            uint8_t r, g, b;
+            corpus_pattern_pixel(x, y, width, height, &r, &g, &b);
+            tile[x+y*width] = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);    // RGB565, like JPEGDecoder
+        }
+    String screen = String(width) + "x" + String(height) + " (screen)";
+#if defined(VARIANT_bw)
+    if(prepare_framebuffer(width, height))
+    {
+        drawRGBTile(0, 0, tile.data(), width, height);
+        measure("dither", screen, width*height, iterations,
+                [&]() { framebuffer_to_display(width, height); });
+    }
+#else
+    measure("tile", screen, width*height, iterations,
+            [&]() { drawRGBTile(0, 0, tile.data(), width, height); gfx_flushBuffer(); });
+#endif
+    return 0;
+}
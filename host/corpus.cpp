@@ -0,0 +1,140 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+corpus.cpp - the test images of the benchmark and the verification, implementation
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "esplayer.h"
+#include "gfxsniff.h"
+#include "corpus.h"
+
+// the generated part of the corpus
+static const struct { uint16_t width, height; } corpus_sizes[] = { {64, 32}, {128, 64}, {128, 128}, {320, 240}, {640, 480} };
+static const uint8_t corpus_depths[] = { 1, 24 };
+
+void corpus_pattern_pixel(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+    *r = x*255/width;
+    *g = y*255/height;
+    *b = ((x^y) & 0x1f) << 3;
+}
+
+static void put16(File &f, uint16_t v)  { f.write(v & 0xff); f.write(v >> 8); }
+static void put32(File &f, uint32_t v)  { put16(f, v & 0xffff); put16(f, v >> 16); }
+
+static bool writeBMP(const char *filename, uint32_t width, uint32_t height, uint8_t depth)
+{
+    uint32_t rowSize = ((width*depth + 31) / 32) * 4,
+             palette = (depth == 1) ? 2*4 : 0,
+             imageOffset = 14 + 40 + palette;
+    std::vector<uint8_t> row(rowSize);
+    File f = ESP_FS.open(filename, "w");
+
+    if(!f)  return false;
+    f.write('B'); f.write('M');
+    put32(f, imageOffset + rowSize*height);
+    put32(f, 0);
+    put32(f, imageOffset);
+    put32(f, 40);                   // BITMAPINFOHEADER
+    put32(f, width);
+    put32(f, height);
+    put16(f, 1);                    // planes
+    put16(f, depth);
+    put32(f, 0);                    // uncompressed
+    put32(f, rowSize*height);
+    put32(f, 2835); put32(f, 2835); // 72 dpi
+    put32(f, (depth == 1) ? 2 : 0); // colors used
+    put32(f, 0);
+    if(depth == 1)
+    {
+        put32(f, 0x000000);
+        put32(f, 0xffffff);
+    }
+    for(uint32_t y = height; y-- > 0; )     // bottom-to-top
+    {
+        std::fill(row.begin(), row.end(), 0);
+        for(uint32_t x = 0; x < width; ++x)
+        {
+            uint8_t r, g, b;
+            corpus_pattern_pixel(x, y, width, height, &r, &g, &b);
+            if(depth == 24)
+            {
+                row[x*3]   = b;
+                row[x*3+1] = g;
+                row[x*3+2] = r;
+            }
+            else if((uint32_t)(r+g+b) > ((x*7+y*13) % 3+1)*255*3/4)     // a crude ordered dither, so it's no plain gradient
+                row[x/8] |= 0x80 >> (x%8);
+        }
+        f.write(row.data(), rowSize);
+    }
+    f.close();
+    return true;
+}
+
+static bool generateBMPs(void)
+{
+    for(auto size : corpus_sizes)
+        for(uint8_t depth : corpus_depths)
+        {
+            String filename = "/bmp" + String(depth) + "_" + String(size.width) + "x" + String(size.height) + ".bmp";
+            if(!ESP_FS.exists(filename) && !writeBMP(filename.c_str(), size.width, size.height, depth))
+            {
+                fprintf(stderr, "can't write %s\n", filename.c_str());
+                return false;
+            }
+        }
+    return true;
+}
+
+// the image size, as the sniffer of the upload sees it
+static bool imageSize(const String &filename, corpusImage *image)
+{
+    gfxFileInfo info;
+
+    if(!sniffFile(filename.c_str(), &info)) return false;
+    image->filename = filename;
+    image->width = info.width;
+    image->height = info.height;
+    return true;
+}
+
+std::vector<corpusImage> corpus_find(const char *extension)
+{
+    std::vector<corpusImage> images;
+    File dir = ESP_FS.open("/", "r");
+    File file;
+
+    while((file = dir.openNextFile()))
+    {
+        String filename = file.path();
+        corpusImage image;
+        file.close();
+        if(filename.endsWith(extension) && imageSize(filename, &image))
+            images.push_back(image);
+    }
+    std::sort(images.begin(), images.end(),
+              [](const corpusImage &a, const corpusImage &b) { return (a.width*a.height < b.width*b.height) ||
+                                                                    ((a.width*a.height == b.width*b.height) && (a.filename < b.filename)); });
+    return images;
+}
+
+bool corpus_open(const char *directory)
+{
+    mkdir(directory, 0777);
+    ESP_FS.setRoot(directory);
+    if(!esp_fs_begin())
+    {
+        fprintf(stderr, "%s is no directory\n", directory);
+        return false;
+    }
+    return generateBMPs();
+}
@@ -0,0 +1,34 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+corpus.h - the test images of the benchmark and the verification (bench.cpp, verify.cpp)
+
+The corpus is a directory serving as the filesystem (ESP_FS). The BMP files (1 and 24 bit, several sizes)
+are generated into it unless they exist; JPEG files can't be generated (see "make corpus").
+
+*/
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <Arduino.h>
+#include <vector>
+
+struct corpusImage
+{
+    String filename;
+    uint32_t width, height;
+};
+
+// use the directory as filesystem, generating the missing BMP files; false on error (reported to stderr)
+bool corpus_open(const char *directory);
+
+// the valid images in the corpus with that extension (e.g. ".bmp"), smallest first
+std::vector<corpusImage> corpus_find(const char *extension);
+
+// the test pattern: gradients plus some texture, so neither the dithering nor the JPEG coding degenerates
+void corpus_pattern_pixel(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t *r, uint8_t *g, uint8_t *b);
+
+#endif CORPUS_H
@@ -0,0 +1,199 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+host.cpp - implementation of the host shims (Arduino.h, FS.h) for the native build
+
+*/
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <LittleFS.h>
+#include <SD.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+HardwareSerial Serial;
+
+/*********************************************************************/
+// time
+
+static struct timespec start_time;
+static bool start_time_set = false;
+
+unsigned long micros(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(!start_time_set)
+    {
+        start_time = now;
+        start_time_set = true;
+    }
+    return (now.tv_sec - start_time.tv_sec) * 1000000UL + (now.tv_nsec - start_time.tv_nsec) / 1000;
+}
+
+unsigned long millis(void)
+{
+    return micros() / 1000;
+}
+
+void delay(unsigned long ms)
+{
+    usleep(ms * 1000);
+}
+
+/*********************************************************************/
+// filesystem
+
+fs::FS SPIFFS("SPIFFS"), LittleFS("LittleFS"), SD("SD");
+
+namespace fs
+{
+
+struct FileState
+{
+    FILE *fp = NULL;
+    DIR *dir = NULL;
+    std::string hostpath;   // the real path
+    std::string path;       // as seen by the sketch
+    const FS *fs = NULL;
+
+    ~FileState()
+    {
+        if(fp)  fclose(fp);
+        if(dir) closedir(dir);
+    }
+};
+
+size_t File::write(uint8_t c)                       { return write(&c, 1); }
+size_t File::write(const uint8_t *buf, size_t size) { return (_state && _state->fp) ? fwrite(buf, 1, size, _state->fp) : 0; }
+int File::available(void)                           { return (_state && _state->fp) ? size() - position() : 0; }
+int File::read(void)                                { return (_state && _state->fp) ? fgetc(_state->fp) : -1; }
+size_t File::read(uint8_t *buf, size_t size)        { return (_state && _state->fp) ? fread(buf, 1, size, _state->fp) : 0; }
+size_t File::position(void) const                   { return (_state && _state->fp) ? ftell(_state->fp) : 0; }
+void File::flush(void)                              { if(_state && _state->fp) fflush(_state->fp); }
+void File::close(void)                              { _state.reset(); }
+File::operator bool() const                         { return _state && (_state->fp || _state->dir); }
+const char *File::path(void) const                  { return _state ? _state->path.c_str() : ""; }
+bool File::isDirectory(void) const                  { return _state && _state->dir; }
+
+int File::peek(void)
+{
+    int c = read();
+    if(c >= 0)  ungetc(c, _state->fp);
+    return c;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+    static const int whence[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+    return _state && _state->fp && (fseek(_state->fp, pos, whence[mode]) == 0);
+}
+
+size_t File::size(void) const
+{
+    struct stat st;
+    if(!_state || !_state->fp)  return 0;
+    fflush(_state->fp);
+    return (fstat(fileno(_state->fp), &st) == 0) ? st.st_size : 0;
+}
+
+time_t File::getLastWrite(void) const
+{
+    struct stat st;
+    if(!_state || !_state->fp)  return 0;
+    return (fstat(fileno(_state->fp), &st) == 0) ? st.st_mtime : 0;
+}
+
+const char *File::name(void) const
+{
+    if(!_state) return "";
+    const char *slash = strrchr(_state->path.c_str(), '/');
+    return slash ? slash+1 : _state->path.c_str();
+}
+
+File File::openNextFile(const char *mode)
+{
+    struct dirent *entry;
+
+    if(!_state || !_state->dir) return File();
+    while((entry = readdir(_state->dir)))
+    {
+        if(entry->d_name[0] == '.') continue;   // ".", ".." and hidden files
+        std::string path = _state->path + ((_state->path == "/") ? "" : "/") + entry->d_name;
+        return const_cast<FS *>(_state->fs)->open(path.c_str(), mode);
+    }
+    return File();
+}
+
+bool FS::begin(bool formatOnFail)
+{
+    struct stat st;
+    return (stat(_root.c_str(), &st) == 0) && S_ISDIR(st.st_mode);
+}
+
+size_t FS::totalBytes(void)
+{
+    struct statvfs sv;
+    return (statvfs(_root.c_str(), &sv) == 0) ? sv.f_blocks * sv.f_frsize : 0;
+}
+
+size_t FS::usedBytes(void)
+{
+    struct statvfs sv;
+    return (statvfs(_root.c_str(), &sv) == 0) ? (sv.f_blocks - sv.f_bavail) * sv.f_frsize : 0;
+}
+
+File FS::open(const char *path, const char *mode)
+{
+    std::shared_ptr<FileState> state = std::make_shared<FileState>();
+    struct stat st;
+    std::string fmode = mode;
+
+    state->hostpath = hostPath(path);
+    state->path = (*path == '/') ? path : std::string("/") + path;
+    state->fs = this;
+    if((fmode == "r") && (stat(state->hostpath.c_str(), &st) == 0) && S_ISDIR(st.st_mode))
+        state->dir = opendir(state->hostpath.c_str());
+    else
+    {
+        fmode += "b";   // no difference on POSIX, but states the intention
+        state->fp = fopen(state->hostpath.c_str(), fmode.c_str());
+    }
+    if(!state->fp && !state->dir)   return File();
+    return File(state);
+}
+
+bool FS::exists(const char *path)
+{
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path)
+{
+    return ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to)
+{
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+} // namespace fs
+
+/*********************************************************************/
+// displays
+
+#include <U8g2lib.h>
+#include <Ucglib.h>
+
+const u8g2_font_t u8g2_font_ncenR10_tr[] = { 0 };
+const ucg_fntpgm_uint8_t ucg_font_ncenR10_tr[] = { 0 };
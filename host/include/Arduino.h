@@ -0,0 +1,100 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+host/include/Arduino.h - the part of the Arduino API used by the render code, for the native build
+
+*/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <string>
+#include "pgmspace.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define F(s)    (s)
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+inline void yield(void) {}
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// Arduino's String, as far as the render code (and JPEGDecoder) use it
+class String : public std::string
+{
+public:
+    String() {}
+    String(const char *s) : std::string(s ? s : "") {}
+    String(const std::string &s) : std::string(s) {}
+    String(char c) : std::string(1, c) {}
+    String(int v)           : std::string(std::to_string(v)) {}
+    String(unsigned int v)  : std::string(std::to_string(v)) {}
+    String(long v)          : std::string(std::to_string(v)) {}
+    String(unsigned long v) : std::string(std::to_string(v)) {}
+    String(double v, int decimals = 2) { char buf[32]; snprintf(buf, sizeof(buf), "%.*f", decimals, v); assign(buf); }
+
+    char charAt(unsigned int i) const   { return (i < length()) ? (*this)[i] : 0; }
+    int indexOf(char c) const           { size_t p = find(c); return (p == npos) ? -1 : (int)p; }
+    int lastIndexOf(char c) const       { size_t p = rfind(c); return (p == npos) ? -1 : (int)p; }
+    String substring(unsigned int from) const                   { return (from < length()) ? String(substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const  { return (from < to && from < length()) ? String(substr(from, to-from)) : String(); }
+    bool startsWith(const String &s) const  { return compare(0, s.length(), s) == 0; }
+    bool endsWith(const String &s) const    { return (length() >= s.length()) && (compare(length()-s.length(), s.length(), s) == 0); }
+    bool equals(const String &s) const      { return *this == s; }
+    long toInt(void) const                  { return atol(c_str()); }
+};
+
+inline String operator+(const String &a, const String &b)   { return String(static_cast<const std::string &>(a) + static_cast<const std::string &>(b)); }
+inline String operator+(const String &a, const char *b)     { return String(static_cast<const std::string &>(a) + b); }
+inline String operator+(const char *a, const String &b)     { return String(a + static_cast<const std::string &>(b)); }
+inline String operator+(const String &a, char b)            { return String(static_cast<const std::string &>(a) + b); }
+
+// output goes to stderr - stdout may be used by the tools
+class Print
+{
+public:
+    size_t print(const char *s)     { return fputs(s, stderr) >= 0 ? strlen(s) : 0; }
+    size_t print(const String &s)   { return print(s.c_str()); }
+    size_t print(char c)            { return fputc(c, stderr) != EOF; }
+    size_t print(int v)             { return fprintf(stderr, "%d", v); }
+    size_t print(unsigned int v)    { return fprintf(stderr, "%u", v); }
+    size_t print(long v)            { return fprintf(stderr, "%ld", v); }
+    size_t print(unsigned long v)   { return fprintf(stderr, "%lu", v); }
+    size_t print(double v)          { return fprintf(stderr, "%.2f", v); }
+    size_t println(void)            { return print('\n'); }
+    template<typename T> size_t println(T v)    { size_t n = print(v); return n + println(); }
+    size_t write(const uint8_t *buf, size_t len)    { return fwrite(buf, 1, len, stderr); }
+};
+
+class HardwareSerial : public Print
+{
+public:
+    bool quiet = false;     // the tools may silence the diagnostic output of the render code
+    void begin(unsigned long) {}
+    operator bool() const { return true; }
+    int availableForWrite(void)     { return quiet ? 0 : 4096; }    // quiet: the log stays in its buffer
+    size_t print(const char *s)     { return quiet ? 0 : Print::print(s); }
+    template<typename T> size_t print(T v)      { return quiet ? 0 : Print::print(v); }
+    size_t println(void)            { return quiet ? 0 : Print::println(); }
+    template<typename T> size_t println(T v)    { return quiet ? 0 : Print::println(v); }
+};
+
+extern HardwareSerial Serial;
+
+#endif HOST_ARDUINO_H
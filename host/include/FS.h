@@ -0,0 +1,96 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+host/include/FS.h - fs::FS and fs::File of the ESP cores, backed by a directory of the host (POSIX)
+
+a path "/name" of the sketch is <root>/name on the host; the root is set by FS::setRoot().
+
+*/
+
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <Arduino.h>
+#include <memory>
+
+namespace fs
+{
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FileState;   // the open file or directory (host_fs.cpp)
+
+class File
+{
+public:
+    File() {}
+    File(std::shared_ptr<FileState> state) : _state(state) {}
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buf, size_t size);
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t read(uint8_t *buf, size_t size);
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position(void) const;
+    size_t size(void) const;
+    void flush(void);
+    void close(void);
+    operator bool() const;
+    const char *name(void) const;   // without the directory
+    const char *path(void) const;   // as seen by the sketch, i.e. with leading '/'
+    bool isDirectory(void) const;
+    time_t getLastWrite(void) const;
+    File openNextFile(const char *mode = "r");
+
+private:
+    std::shared_ptr<FileState> _state;
+};
+
+class FS
+{
+public:
+    FS(const char *name) : _name(name) {}
+
+    void setRoot(const char *root)  { _root = root; }
+    const std::string &root(void) const { return _root; }
+
+    bool begin(bool formatOnFail = false);
+    void end(void) {}
+    bool format(void)   { return false; }
+    size_t totalBytes(void);
+    size_t usedBytes(void);
+
+    File open(const char *path, const char *mode = "r");
+    File open(const String &path, const char *mode = "r")   { return open(path.c_str(), mode); }
+    bool exists(const char *path);
+    bool exists(const String &path)     { return exists(path.c_str()); }
+    bool remove(const char *path);
+    bool remove(const String &path)     { return remove(path.c_str()); }
+    bool rename(const char *from, const char *to);
+    bool rename(const String &from, const String &to)   { return rename(from.c_str(), to.c_str()); }
+
+private:
+    std::string hostPath(const char *path) const    { return _root + ((*path == '/') ? "" : "/") + path; }
+    const char *_name;
+    std::string _root = ".";
+};
+
+} // namespace fs
+
+// the ESP cores make these global (unless FS_NO_GLOBALS), the sketch relies on that anyway
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#define FILE_READ       "r"
+#define FILE_WRITE      "w"
+#define FILE_APPEND     "a"
+
+#endif HOST_FS_H
@@ -0,0 +1,17 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+host/include/LittleFS.h - all filesystems of the native build are the same directory of the host (see FS.h)
+
+*/
+
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+#include <FS.h>
+
+extern fs::FS LittleFS;
+
+#endif HOST_LITTLEFS_H
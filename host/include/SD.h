@@ -0,0 +1,17 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+host/include/SD.h - all filesystems of the native build are the same directory of the host (see FS.h)
+
+*/
+
+#ifndef HOST_SD_H
+#define HOST_SD_H
+
+#include <FS.h>
+
+extern fs::FS SD;
+
+#endif HOST_SD_H
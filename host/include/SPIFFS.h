@@ -0,0 +1,17 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+host/include/SPIFFS.h - all filesystems of the native build are the same directory of the host (see FS.h)
+
+*/
+
+#ifndef HOST_SPIFFS_H
+#define HOST_SPIFFS_H
+
+#include <FS.h>
+
+extern fs::FS SPIFFS;
+
+#endif HOST_SPIFFS_H
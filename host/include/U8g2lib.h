@@ -0,0 +1,94 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+host/include/U8g2lib.h - a u8g2 "display" for the native build: the pixels go to a framebuffer in memory
+
+sendBuffer() copies the drawing buffer to the "display" and counts; the tools read it (display(), writePGM()).
+Only what gfxlayer.h needs is implemented; text is not drawn at all.
+
+*/
+
+#ifndef HOST_U8G2LIB_H
+#define HOST_U8G2LIB_H
+
+#include <Arduino.h>
+#include <vector>
+
+typedef const void *u8g2_cb_t;
+typedef uint8_t u8g2_font_t;
+
+#define U8G2_R0         ((u8g2_cb_t)0)
+#define U8X8_PIN_NONE   255
+
+extern const u8g2_font_t u8g2_font_ncenR10_tr[];
+
+class U8G2
+{
+public:
+    U8G2(uint16_t width, uint16_t height)
+        : _width(width), _height(height), _buffer(width*height), _display(width*height) {}
+
+    void begin(void)                    {}
+    void setContrast(uint8_t)           {}
+    void setFont(const u8g2_font_t *)   {}
+    void setDrawColor(uint8_t c)        { _color = c; }
+    uint16_t getDisplayWidth(void) const    { return _width; }
+    uint16_t getDisplayHeight(void) const   { return _height; }
+
+    void clearBuffer(void)              { std::fill(_buffer.begin(), _buffer.end(), 0); }
+    void clearDisplay(void)             { clearBuffer(); sendBuffer(); }
+    void sendBuffer(void)               { _display = _buffer; ++_sends; }
+    void drawStr(uint16_t, uint16_t, const char *)  {}
+    // the buffer is kept a byte per pixel here, not in the layout of u8g2: no direct access
+    uint8_t *getBufferPtr(void)         { return NULL; }
+    uint8_t getBufferTileWidth(void) const  { return (_width + 7) / 8; }
+    uint8_t getBufferTileHeight(void) const { return (_height + 7) / 8; }
+    void updateDisplayArea(uint8_t, uint8_t, uint8_t, uint8_t)  { sendBuffer(); }
+
+    void drawPixel(uint16_t x, uint16_t y)  // colors as u8g2: 0 clears, 1 sets, 2 toggles
+    {
+        ++_pixels;      // the calls count, even if clipped
+        if(x >= _width || y >= _height) return;     // u8g2 clips silently, too
+        uint8_t &p = _buffer[x+y*_width];
+        p = (_color == 2) ? !p : _color;
+    }
+
+    // for the tools:
+    const uint8_t *display(void) const  { return _display.data(); }     // 1 byte per pixel, 0 or 1
+    unsigned long sendCount(void) const { return _sends; }
+    unsigned long pixelCount(void) const    { return _pixels; }    // calls of drawPixel()
+    void resetCounts(void)              { _sends = _pixels = 0; }
+    bool writePGM(const char *filename) const   // what the display shows, as "portable graymap"
+    {
+        FILE *f = fopen(filename, "wb");
+        if(!f)  return false;
+        fprintf(f, "P5\n%u %u\n255\n", _width, _height);
+        for(uint8_t p : _display)   fputc(p ? 255 : 0, f);
+        return fclose(f) == 0;
+    }
+
+private:
+    uint16_t _width, _height;
+    std::vector<uint8_t> _buffer, _display;
+    uint8_t _color = 1;
+    unsigned long _sends = 0, _pixels = 0;
+};
+
+// the constructors of the real classes take rotation and pins, which do not matter here
+#define U8G2_HOST_DISPLAY(name, w, h)                                   \
+    class U8G2_##name : public U8G2                                     \
+    {                                                                   \
+    public:                                                             \
+        template<typename... Args> U8G2_##name(Args...) : U8G2(w, h) {} \
+    };
+
+U8G2_HOST_DISPLAY(SSD1306_128X64_NONAME_F_HW_I2C, 128, 64)
+U8G2_HOST_DISPLAY(SSD1306_128X64_NONAME_F_SW_I2C, 128, 64)
+U8G2_HOST_DISPLAY(SSD1306_128X64_NONAME_F_4W_HW_SPI, 128, 64)
+U8G2_HOST_DISPLAY(SSD1306_128X32_UNIVISION_F_HW_I2C, 128, 32)
+U8G2_HOST_DISPLAY(SH1106_128X64_NONAME_F_HW_I2C, 128, 64)
+U8G2_HOST_DISPLAY(SSD1327_MIDAS_128X128_F_4W_HW_SPI, 128, 128)
+
+#endif HOST_U8G2LIB_H
@@ -0,0 +1,89 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+host/include/Ucglib.h - a ucglib "display" for the native build: the pixels go to an RGB framebuffer in memory
+
+ucglib writes to the display immediately, so there is no sendBuffer(); the tools read the framebuffer
+(display(), writePPM()). Only what gfxlayer.h needs is implemented; text is not drawn at all.
+
+*/
+
+#ifndef HOST_UCGLIB_H
+#define HOST_UCGLIB_H
+
+#include <Arduino.h>
+#include <vector>
+
+typedef uint8_t ucg_fntpgm_uint8_t;
+
+#define UCG_FONT_MODE_TRANSPARENT   0
+#define UCG_FONT_MODE_SOLID         1
+
+extern const ucg_fntpgm_uint8_t ucg_font_ncenR10_tr[];
+
+class Ucglib
+{
+public:
+    Ucglib(uint16_t width, uint16_t height)
+        : _width(width), _height(height), _display(width*height*3) {}
+
+    void begin(uint8_t)                 {}
+    void setFont(const ucg_fntpgm_uint8_t *) {}
+    void setFontMode(uint8_t)           {}
+    void setColor(uint8_t r, uint8_t g, uint8_t b)  { _r = r; _g = g; _b = b; }
+    uint16_t getWidth(void) const       { return _width; }
+    uint16_t getHeight(void) const      { return _height; }
+
+    void clearScreen(void)              { std::fill(_display.begin(), _display.end(), 0); }
+    void drawString(uint16_t, uint16_t, uint8_t, const char *)   {}
+
+    void drawPixel(uint16_t x, uint16_t y)
+    {
+        ++_pixels;      // the calls count, even if clipped
+        if(x >= _width || y >= _height) return;     // ucglib clips, too
+        uint8_t *p = &_display[(x+y*_width)*3];
+        p[0] = _r; p[1] = _g; p[2] = _b;
+    }
+
+    void drawHLine(uint16_t x, uint16_t y, uint16_t len)
+    {
+        while(len--)    drawPixel(x++, y);
+    }
+
+    // for the tools:
+    const uint8_t *display(void) const  { return _display.data(); }     // 3 bytes per pixel: r, g, b
+    unsigned long pixelCount(void) const    { return _pixels; }    // calls of drawPixel()
+    void resetCounts(void)              { _pixels = 0; }
+    bool writePPM(const char *filename) const   // what the display shows, as "portable pixmap"
+    {
+        FILE *f = fopen(filename, "wb");
+        if(!f)  return false;
+        fprintf(f, "P6\n%u %u\n255\n", _width, _height);
+        fwrite(_display.data(), 1, _display.size(), f);
+        return fclose(f) == 0;
+    }
+
+private:
+    uint16_t _width, _height;
+    std::vector<uint8_t> _display;
+    uint8_t _r = 255, _g = 255, _b = 255;
+    unsigned long _pixels = 0;
+};
+
+// the constructors of the real classes take pins, which do not matter here
+#define UCG_HOST_DISPLAY(name, w, h)                                    \
+    class Ucglib_##name : public Ucglib                                 \
+    {                                                                   \
+    public:                                                             \
+        template<typename... Args> Ucglib_##name(Args...) : Ucglib(w, h) {} \
+    };
+
+UCG_HOST_DISPLAY(SSD1351_18x128x128_HWSPI, 128, 128)
+UCG_HOST_DISPLAY(SSD1351_18x128x128_SWSPI, 128, 128)
+UCG_HOST_DISPLAY(SSD1331_18x96x64_UNIVISION_HWSPI, 96, 64)
+UCG_HOST_DISPLAY(ST7735_18x128x160_HWSPI, 128, 160)
+UCG_HOST_DISPLAY(ILI9341_18x240x320_HWSPI, 240, 320)
+
+#endif HOST_UCGLIB_H
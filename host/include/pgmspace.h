@@ -0,0 +1,21 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+host/include/pgmspace.h - there is no separate program memory on the host
+
+*/
+
+#ifndef HOST_PGMSPACE_H
+#define HOST_PGMSPACE_H
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s)                 (s)
+#define pgm_read_byte(addr)     (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)     (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)    (*(const uint32_t *)(addr))
+
+#endif HOST_PGMSPACE_H
@@ -0,0 +1,114 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+render_tool.cpp - draw image files on the host, using the render code of the sketch (bw or color)
+
+usage: render_<variant> [-r root] [-o outdir] [-q] [-w cols,rows,col,row] /image ...
+
+The images are looked up below root (the "filesystem", default: current directory) like on the ESP.
+For each image, the time taken and the pixel count are printed; with -o, what the display shows
+afterwards is written to outdir as .pgm (bw) or .ppm (color). -w draws the part of a video wall
+(see render_set_wall()) one display shows.
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include <unistd.h>
+#include "esplayer.h"
+#if defined(VARIANT_bw)
+#include <U8g2lib.h>
+U8G2_CONSTRUCTION;
+#define gfx_device      u8g2
+#define OUTPUT_EXT      ".pgm"
+#define writeDisplay    writePGM
+#elif defined(VARIANT_color)
+#include <Ucglib.h>
+UCG_CONSTRUCTION;
+#define gfx_device      ucg
+#define OUTPUT_EXT      ".ppm"
+#define writeDisplay    writePPM
+#else
+#error "define VARIANT_bw or VARIANT_color"
+#endif
+#include "gfxlayer.h"
+#include "render.h"
+#include "log.h"
+
+static void usage(const char *self)
+{
+    fprintf(stderr, "usage: %s [-r root] [-o outdir] [-q] [-w cols,rows,col,row] /image ...\n"
+                    "  -r root    directory serving as the filesystem (default: .)\n"
+                    "  -o outdir  write what the display shows after each image to outdir\n"
+                    "  -q         suppress the diagnostic output (log) of the render code\n"
+                    "  -w c,r,x,y show the part of display x,y (0,0: top left) of a wall of c*r displays\n", self);
+}
+
+int main(int argc, char **argv)
+{
+    const char *outdir = NULL;
+    int opt, result = 0;
+    unsigned cols, rows, col, row;
+
+    while((opt = getopt(argc, argv, "r:o:qw:")) != -1)
+        switch(opt)
+        {
+        case 'r':   ESP_FS.setRoot(optarg); break;
+        case 'o':   outdir = optarg;        break;
+        case 'q':   Serial.quiet = true;    break;
+        case 'w':
+            if(sscanf(optarg, "%u,%u,%u,%u", &cols, &rows, &col, &row) != 4)
+            {
+                usage(argv[0]);
+                return 2;
+            }
+            render_set_wall(cols, rows, col, row);
+            break;
+        default:    usage(argv[0]);         return 2;
+        }
+    if(optind >= argc)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    if(!esp_fs_begin())
+    {
+        fprintf(stderr, "%s: root %s is no directory\n", argv[0], ESP_FS.root().c_str());
+        return 1;
+    }
+    gfx_init();
+
+    for(int i = optind; i < argc; ++i)
+    {
+        String filename = argv[i];
+        if(!filename.startsWith("/"))   filename = "/" + filename;
+        if(!ESP_FS.exists(filename))
+        {
+            fprintf(stderr, "%s: %s not found\n", argv[0], filename.c_str());
+            result = 1;
+            continue;
+        }
+
+        gfx_device.resetCounts();
+        unsigned long start = micros();
+        drawAnyImageType(filename.c_str());
+        unsigned long duration = micros() - start;
+        log_drain();
+        printf("%s: %lu us, %lu pixels drawn\n", filename.c_str(), duration, gfx_device.pixelCount());
+
+        if(outdir)
+        {
+            String base = filename.substring(filename.lastIndexOf('/')+1),
+                   output = String(outdir) + "/" + base + OUTPUT_EXT;
+            if(!gfx_device.writeDisplay(output.c_str()))
+            {
+                fprintf(stderr, "%s: can't write %s\n", argv[0], output.c_str());
+                result = 1;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,348 @@
+/*
+
+Tobis General Display
+by Arnold Schommer
+
+verify.cpp - compare what the render code shows with golden images, to catch unintended changes
+
+usage: verify_<variant> [-c corpus] [-g golden] [-u] [-t tolerance]
+
+Every image of the corpus (see corpus.h) is drawn, plus a full screen test pattern run through the step after
+JPEG decoding (framebuffer_to_display() for bw, drawRGBTile() for color). What the display shows afterwards
+is compared with <golden>/<image>.pbm (bw: 1 bit per pixel) or .ppm (color: compared as RGB565, what the
+panel gets). -u writes the golden images instead - do that before changing a kernel, with the unchanged code.
+
+The largest 1 bit BMP of the corpus is drawn on a video wall, too (see render_set_wall()): each display's
+part is compared with the file itself - without dithering, every pixel is known, no golden image needed.
+
+Without -t the comparison is bit-exact. With -t, an intentionally changed kernel (e.g. another dithering)
+may set other pixels as long as the average brightness of every 4x4 block stays within tolerance (0..255,
+per color channel for color).
+
+*/
+
+#include "pre-config.h"
+#include "config.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <vector>
+#include "esplayer.h"
+#if defined(VARIANT_bw)
+#include <U8g2lib.h>
+U8G2_CONSTRUCTION;
+#define gfx_device      u8g2
+#define VARIANT         "bw"
+#define CHANNELS        1
+#define GOLDEN_EXT      ".pbm"
+#elif defined(VARIANT_color)
+#include <Ucglib.h>
+UCG_CONSTRUCTION;
+#define gfx_device      ucg
+#define VARIANT         "color"
+#define CHANNELS        3
+#define GOLDEN_EXT      ".ppm"
+#else
+#error "define VARIANT_bw or VARIANT_color"
+#endif
+#include "gfxlayer.h"
+#include "render.h"
+#include "corpus.h"
+
+#define BLOCK_SIZE      4   // edge length of the blocks compared with tolerance
+
+// a screen content: 0/1 per pixel (bw) or r, g, b reduced to RGB565 precision (color)
+typedef std::vector<uint8_t> screenImage;
+
+static screenImage captureScreen(void)
+{
+    const uint8_t *pixels = gfx_device.display();
+    screenImage screen(pixels, pixels + gfx_getScreenWidth()*gfx_getScreenHeight()*CHANNELS);
+
+#if defined(VARIANT_color)
+    for(size_t i = 0; i < screen.size(); i += 3)
+    {
+        screen[i]   &= 0xf8;
+        screen[i+1] &= 0xfc;
+        screen[i+2] &= 0xf8;
+    }
+#endif
+    return screen;
+}
+
+static bool writeGolden(const String &filename, const screenImage &screen)
+{
+    uint16_t width = gfx_getScreenWidth(), height = gfx_getScreenHeight();
+    FILE *f = fopen(filename.c_str(), "wb");
+
+    if(!f)  return false;
+#if defined(VARIANT_bw)
+    fprintf(f, "P4\n%u %u\n", width, height);
+    for(uint16_t y = 0; y < height; ++y)
+        for(uint16_t x = 0; x < width; x += 8)
+        {
+            uint8_t bits = 0;
+            for(uint16_t b = 0; b < 8 && x+b < width; ++b)
+                if(screen[x+b+y*width]) bits |= 0x80 >> b;
+            fputc(bits, f);
+        }
+#else
+    fprintf(f, "P6\n%u %u\n255\n", width, height);
+    fwrite(screen.data(), 1, screen.size(), f);
+#endif
+    return fclose(f) == 0;
+}
+
+static bool readGolden(const String &filename, screenImage *screen)
+{
+    uint16_t width = gfx_getScreenWidth(), height = gfx_getScreenHeight();
+    unsigned int w, h;
+    FILE *f = fopen(filename.c_str(), "rb");
+    bool ok;
+
+    if(!f)  return false;
+#if defined(VARIANT_bw)
+    ok = (fscanf(f, "P4 %u %u", &w, &h) == 2) && (fgetc(f) != EOF) && (w == width) && (h == height);
+    screen->assign(width*height, 0);
+    for(uint16_t y = 0; ok && y < height; ++y)
+        for(uint16_t x = 0; ok && x < width; x += 8)
+        {
+            int bits = fgetc(f);
+            ok = (bits != EOF);
+            for(uint16_t b = 0; ok && b < 8 && x+b < width; ++b)
+                (*screen)[x+b+y*width] = (bits >> (7-b)) & 1;
+        }
+#else
+    unsigned int maxval;
+    ok = (fscanf(f, "P6 %u %u %u", &w, &h, &maxval) == 3) && (fgetc(f) != EOF) &&
+         (w == width) && (h == height) && (maxval == 255);
+    screen->resize(width*height*3);
+    ok = ok && (fread(screen->data(), 1, screen->size(), f) == screen->size());
+#endif
+    fclose(f);
+    return ok;
+}
+
+// average brightness of a block, one channel, scaled to 0..255
+static unsigned int blockMean(const screenImage &screen, uint16_t bx, uint16_t by, uint8_t channel)
+{
+    uint16_t width = gfx_getScreenWidth(), height = gfx_getScreenHeight();
+    unsigned int sum = 0, count = 0;
+
+    for(uint16_t y = by; y < by+BLOCK_SIZE && y < height; ++y)
+        for(uint16_t x = bx; x < bx+BLOCK_SIZE && x < width; ++x, ++count)
+            sum += screen[(x+y*width)*CHANNELS+channel];
+#if defined(VARIANT_bw)
+    sum *= 255;
+#endif
+    return sum / count;
+}
+
+// returns the number of differing pixels; *max_diff is set to the largest difference of block brightness
+static unsigned long compareScreens(const screenImage &a, const screenImage &b, unsigned int *max_diff)
+{
+    uint16_t width = gfx_getScreenWidth(), height = gfx_getScreenHeight();
+    unsigned long differing = 0;
+
+    for(size_t i = 0; i < a.size(); i += CHANNELS)
+        if(memcmp(&a[i], &b[i], CHANNELS))  ++differing;
+    *max_diff = 0;
+    for(uint16_t by = 0; by < height; by += BLOCK_SIZE)
+        for(uint16_t bx = 0; bx < width; bx += BLOCK_SIZE)
+            for(uint8_t c = 0; c < CHANNELS; ++c)
+            {
+                unsigned int ma = blockMean(a, bx, by, c), mb = blockMean(b, bx, by, c),
+                             diff = (ma > mb) ? ma-mb : mb-ma;
+                if(diff > *max_diff)    *max_diff = diff;
+            }
+    return differing;
+}
+
+// draw (by the function given), then compare with or update the golden image; false if it doesn't match
+template<typename F> static bool check(const String &name, const String &golden_dir, bool update, int tolerance, F draw)
+{
+    String golden = golden_dir + "/" + name + GOLDEN_EXT;
+    screenImage expected, actual;
+    unsigned int max_diff;
+    unsigned long differing;
+
+    gfx_clearScreen();
+    draw();
+    actual = captureScreen();
+
+    if(update)
+    {
+        if(!writeGolden(golden, actual))
+        {
+            printf("%-28s can't write %s\n", name.c_str(), golden.c_str());
+            return false;
+        }
+        printf("%-28s written\n", name.c_str());
+        return true;
+    }
+    if(!readGolden(golden, &expected))
+    {
+        printf("%-28s FAILED: no valid golden image %s (-u creates it)\n", name.c_str(), golden.c_str());
+        return false;
+    }
+    differing = compareScreens(expected, actual, &max_diff);
+    if(differing == 0)
+    {
+        printf("%-28s ok\n", name.c_str());
+        return true;
+    }
+    if(tolerance >= 0 && max_diff <= (unsigned int)tolerance)
+    {
+        printf("%-28s ok within tolerance: %lu pixels differ, block brightness by up to %u\n", name.c_str(), differing, max_diff);
+        return true;
+    }
+    printf("%-28s FAILED: %lu pixels differ, block brightness by up to %u\n", name.c_str(), differing, max_diff);
+    return false;
+}
+
+// draw filename (a 1 bit BMP larger than the display) on each display of a wall just large enough for it;
+// false if some display doesn't show its part of the image exactly
+static bool checkWall(const char *filename)
+{
+    String name = String("wall_") + (filename + 1);
+    File f = ESP_FS.open(filename, "r");
+    std::vector<uint8_t> bmp(f ? f.size() : 0);
+    bool read = f && (f.read(bmp.data(), bmp.size()) == bmp.size()) && (bmp.size() > 62);
+    auto le32 = [&](size_t pos) { return bmp[pos] | bmp[pos+1] << 8 | bmp[pos+2] << 16 | (uint32_t)bmp[pos+3] << 24; };
+    unsigned long differing = 0;
+
+    if(f)   f.close();
+    if(!read)
+    {
+        printf("%-28s FAILED: can't read %s\n", name.c_str(), filename);
+        return false;
+    }
+    uint32_t offset = le32(10), width = le32(18), height = le32(22), stride = (width + 31) / 32 * 4;
+    uint16_t screen_w = gfx_getScreenWidth(), screen_h = gfx_getScreenHeight();
+    uint8_t cols = (width + screen_w - 1) / screen_w, rows = (height + screen_h - 1) / screen_h;
+
+    render_set_wall(1, 1, 0, 0);
+    if(render_fits(width, height))
+    {
+        printf("%-28s FAILED: %s is not larger than the display\n", name.c_str(), filename);
+        return false;
+    }
+    render_set_wall(cols, rows, 0, 0);
+    if(!render_fits(width, height))
+    {
+        printf("%-28s FAILED: %s does not fit a wall of %u*%u displays\n", name.c_str(), filename, cols, rows);
+        render_set_wall(1, 1, 0, 0);
+        return false;
+    }
+    for(uint8_t row = 0; row < rows; ++row)
+        for(uint8_t col = 0; col < cols; ++col)
+        {
+            render_set_wall(cols, rows, col, row);
+            gfx_clearScreen();
+            drawAnyImageType(filename);
+            screenImage screen = captureScreen();
+            // the image centered on the wall (the first row of the file is the bottom one)
+            int32_t left = ((int32_t)(cols * screen_w) - (int32_t)width ) / 2 - col * screen_w,
+                    top  = ((int32_t)(rows * screen_h) - (int32_t)height) / 2 - row * screen_h;
+
+            for(uint16_t y = 0; y < screen_h; ++y)
+                for(uint16_t x = 0; x < screen_w; ++x)
+                {
+                    int32_t ix = x - left, iy = y - top;
+                    bool white = (ix >= 0) && (ix < (int32_t)width) && (iy >= 0) && (iy < (int32_t)height) &&
+                                 ((bmp[offset + (height - 1 - iy) * stride + ix / 8] >> (7 - ix % 8)) & 1);  // (palette: black, white)
+#if defined(VARIANT_bw)
+                    if((screen[x + y*screen_w] != 0) != white)  ++differing;
+#else
+                    const uint8_t expected[3] = { (uint8_t)(white ? 0xf8 : 0), (uint8_t)(white ? 0xfc : 0), (uint8_t)(white ? 0xf8 : 0) };
+                    if(memcmp(&screen[(x + y*screen_w) * 3], expected, 3))  ++differing;
+#endif
+                }
+        }
+    render_set_wall(1, 1, 0, 0);
+    if(differing)
+    {
+        printf("%-28s FAILED: %lu pixels differ on a wall of %u*%u displays\n", name.c_str(), differing, cols, rows);
+        return false;
+    }
+    printf("%-28s ok\n", name.c_str());
+    return true;
+}
+
+static void usage(const char *self)
+{
+    fprintf(stderr, "usage: %s [-c corpus] [-g golden] [-u] [-t tolerance]\n"
+                    "  -c corpus     directory of the test images (default: corpus)\n"
+                    "  -g golden     directory of the golden images (default: golden/" VARIANT ")\n"
+                    "  -u            write the golden images instead of comparing\n"
+                    "  -t tolerance  allowed difference of the brightness of 4x4 blocks, 0..255 (default: bit-exact)\n", self);
+}
+
+int main(int argc, char **argv)
+{
+    const char *corpus = "corpus";
+    String golden = "golden/" VARIANT;
+    bool update = false, ok = true;
+    int opt, tolerance = -1;
+
+    while((opt = getopt(argc, argv, "c:g:ut:")) != -1)
+        switch(opt)
+        {
+        case 'c':   corpus = optarg;            break;
+        case 'g':   golden = optarg;            break;
+        case 'u':   update = true;              break;
+        case 't':   tolerance = atoi(optarg);   break;
+        default:    usage(argv[0]);             return 2;
+        }
+    // the golden path may be relative to the current directory, the corpus becomes the root of ESP_FS
+    if(update)
+    {
+        mkdir("golden", 0777);
+        mkdir(golden.c_str(), 0777);
+    }
+    if(!corpus_open(corpus))    return 1;
+
+    Serial.quiet = true;
+    gfx_init();
+    String wall_image;
+    uint32_t wall_image_pixels = 0;
+    for(const char *extension : { ".bmp", ".jpg" })
+        for(const corpusImage &image : corpus_find(extension))
+        {
+            ok &= check(image.filename.substring(1), golden, update, tolerance,
+                        [&]() { drawAnyImageType(image.filename.c_str()); });
+            if(image.filename.startsWith("/bmp1_") &&
+               ((image.width > gfx_getScreenWidth()) || (image.height > gfx_getScreenHeight())) &&
+               (image.width * image.height > wall_image_pixels))
+            {
+                wall_image = image.filename;
+                wall_image_pixels = image.width * image.height;
+            }
+        }
+    if(!update)
+    {
+        if(wall_image.length()) ok &= checkWall(wall_image.c_str());
+        else                    printf("%-28s skipped: no 1 bit BMP larger than the display in the corpus\n", "wall");
+    }
+
+    uint16_t width = gfx_getScreenWidth(), height = gfx_getScreenHeight();
+    std::vector<uint16_t> tile(width*height);
+    for(uint16_t y = 0; y < height; ++y)
+        for(uint16_t x = 0; x < width; ++x)
+        {
+            uint8_t r, g, b;
+            corpus_pattern_pixel(x, y, width, height, &r, &g, &b);
+            tile[x+y*width] = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);    // RGB565, like JPEGDecoder
+        }
+#if defined(VARIANT_bw)
+    if(prepare_framebuffer(width, height))
+    {
+        drawRGBTile(0, 0, tile.data(), width, height);
+        ok &= check("screen", golden, update, tolerance, [&]() { framebuffer_to_display(width, height); });
+    }
+    else    ok = false;
+#else
+    ok &= check("screen", golden, update, tolerance, [&]() { drawRGBTile(0, 0, tile.data(), width, height); gfx_flushBuffer(); });
+#endif
+    return ok ? 0 : 1;
+}